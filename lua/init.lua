@@ -18,18 +18,100 @@ vim.g.neogui_opts_default = {
   bgColor = 0x000000,
   transparency = 1,
   maxFps = 0,
+  predictiveEcho = false,
 }
 vim.g.resolve_neogui_opts = function()
   vim.g.neogui_opts_resolved = vim.tbl_deep_extend("force", vim.g.neogui_opts_default, vim.g.neogui_opts)
 end
 
-vim.api.nvim_create_user_command("NeoguiSession", function(opts)
+local function neogui_channels()
+  local chans = {}
   local uis = vim.api.nvim_list_uis()
   for _, ui in ipairs(uis) do
     local chan_id = ui.chan
     local client = vim.api.nvim_get_chan_info(chan_id).client
     if client and client.name == "neogui" and client.type == "ui" then
-      vim.rpcnotify(chan_id, "session_cmd", unpack(opts.fargs))
+      table.insert(chans, chan_id)
     end
   end
+  return chans
+end
+
+local function neogui_notify(method, ...)
+  for _, chan_id in ipairs(neogui_channels()) do
+    vim.rpcnotify(chan_id, method, ...)
+  end
+end
+
+-- :NeoguiSession new [name] | switch <name> | next | prev
+vim.api.nvim_create_user_command("NeoguiSession", function(opts)
+  neogui_notify("session_cmd", unpack(opts.fargs))
 end, { nargs = "*" })
+
+vim.api.nvim_create_user_command("NeoguiRpcStats", function()
+  for _, chan_id in ipairs(neogui_channels()) do
+    print(vim.rpcrequest(chan_id, "rpc_stats"))
+  end
+end, { nargs = 0 })
+
+vim.api.nvim_create_user_command("NeoguiPredictionStats", function()
+  for _, chan_id in ipairs(neogui_channels()) do
+    print(vim.rpcrequest(chan_id, "prediction_stats"))
+  end
+end, { nargs = 0 })
+
+-- clipboard provider answered by the gui from the system clipboard,
+-- whole yanks go over as one string instead of a list of lines
+local function clipboard_copy(reg)
+  return function(lines, regtype)
+    local chan = neogui_channels()[1]
+    if not chan then return end
+    local text = table.concat(lines, "\n")
+    if regtype == "V" then text = text .. "\n" end
+    vim.rpcrequest(chan, "clipboard_set", reg, text, regtype)
+  end
+end
+
+local function clipboard_paste(reg)
+  return function()
+    local chan = neogui_channels()[1]
+    if not chan then return {} end
+    local result = vim.rpcrequest(chan, "clipboard_get", reg)
+    local text, regtype = result[1], result[2]
+    local lines = vim.split(text, "\n", { plain = true })
+    -- copied from outside nvim, let nvim guess the register type
+    if regtype == "" then return lines end
+    if regtype == "V" and lines[#lines] == "" then table.remove(lines) end
+    return { lines, regtype }
+  end
+end
+
+local neogui_clipboard = {
+  name = "neogui",
+  copy = { ["+"] = clipboard_copy("+"), ["*"] = clipboard_copy("*") },
+  paste = { ["+"] = clipboard_paste("+"), ["*"] = clipboard_paste("*") },
+}
+local prev_clipboard = nil
+local clipboard_installed = false
+
+-- only used while a gui is attached, warm and detached servers
+-- keep their own provider the rest of the time
+local function update_clipboard()
+  local attached = #neogui_channels() > 0
+  if attached == clipboard_installed then return end
+  if attached then
+    prev_clipboard = vim.g.clipboard
+    vim.g.clipboard = neogui_clipboard
+  else
+    vim.g.clipboard = prev_clipboard
+  end
+  clipboard_installed = attached
+  -- the provider is picked once, reload it so it sees the change
+  vim.g.loaded_clipboard_provider = nil
+  vim.cmd("runtime autoload/provider/clipboard.vim")
+end
+
+-- scheduled so a leaving ui is already gone from nvim_list_uis
+vim.api.nvim_create_autocmd({ "UIEnter", "UILeave" }, {
+  callback = function() vim.schedule(update_clipboard) end,
+})
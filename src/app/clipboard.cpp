@@ -0,0 +1,89 @@
+#include "clipboard.hpp"
+
+#include "SDL3/SDL_clipboard.h"
+#include "app/sdl_event.hpp"
+#include "utils/logger.hpp"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+
+// SDL has no register types, remember the last copy of each register
+// so pasting it back keeps linewise/blockwise
+struct ClipboardState {
+  std::mutex mutex;
+  struct Copy {
+    std::shared_ptr<const std::string> text;
+    std::string regtype;
+  };
+  Copy clipboard; // "+"
+  Copy primary;   // "*"
+
+  Copy& Get(std::string_view reg) {
+    return reg == "*" ? primary : clipboard;
+  }
+};
+
+void RegisterClipboard(rpc::Client& client) {
+  auto state = std::make_shared<ClipboardState>();
+
+  // [reg, text, regtype], text is the whole yank joined with newlines
+  client.RegisterHandler(
+    "clipboard_set",
+    [state](const msgpack::object& params, rpc::Reply& reply) {
+      auto [reg, text, regtype] =
+        params.as<std::tuple<std::string, std::string, std::string>>();
+
+      auto shared = std::make_shared<const std::string>(std::move(text));
+      bool primary = reg == "*";
+      bool done = sdl::RunOnMainThread([shared, primary] {
+        bool failed = primary ? SDL_SetPrimarySelectionText(shared->c_str())
+                              : SDL_SetClipboardText(shared->c_str());
+        if (failed) LOG_ERR("clipboard_set: {}", SDL_GetError());
+      });
+      if (!done) {
+        reply.Error("neogui: clipboard timed out");
+        return;
+      }
+
+      {
+        std::scoped_lock lock(state->mutex);
+        auto& copy = state->Get(reg);
+        copy.text = std::move(shared);
+        copy.regtype = std::move(regtype);
+      }
+      reply.Result(true);
+    }
+  );
+
+  // [reg] -> [text, regtype], text is sent as a single bin string,
+  // regtype is empty if the clipboard changed outside of nvim
+  client.RegisterHandler(
+    "clipboard_get",
+    [state](const msgpack::object& params, rpc::Reply& reply) {
+      auto [reg] = params.as<std::tuple<std::string>>();
+
+      auto text = std::make_shared<std::string>();
+      bool primary = reg == "*";
+      bool done = sdl::RunOnMainThread([text, primary] {
+        char* data = primary ? SDL_GetPrimarySelectionText() : SDL_GetClipboardText();
+        if (data == nullptr) return;
+        *text = data;
+        SDL_free(data);
+      });
+      if (!done) {
+        reply.Error("neogui: clipboard timed out");
+        return;
+      }
+
+      std::string regtype;
+      {
+        std::scoped_lock lock(state->mutex);
+        auto& copy = state->Get(reg);
+        if (copy.text && *copy.text == *text) regtype = copy.regtype;
+      }
+      reply.Result(std::tuple(msgpack::type::raw_ref(text->data(), text->size()), regtype));
+    }
+  );
+}
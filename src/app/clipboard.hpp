@@ -0,0 +1,7 @@
+#pragma once
+
+#include "nvim/msgpack_rpc/client.hpp"
+
+// g:clipboard provider backed by the SDL clipboard (see lua/init.lua).
+// Registers the clipboard_set and clipboard_get request handlers.
+void RegisterClipboard(rpc::Client& client);
@@ -8,7 +8,8 @@
 #include <set>
 
 InputHandler::InputHandler(Nvim& nvim, WinManager& winManager, bool macOptAsAlt, bool multigrid)
-    : nvim(nvim), winManager(winManager), macOptAsAlt(macOptAsAlt), multigrid(multigrid) {
+    : nvim(nvim), winManager(winManager), macOptAsAlt(macOptAsAlt), multigrid(multigrid),
+      paste(nvim) {
 }
 
 const std::set<SDL_Keycode> specialKeys{
@@ -42,34 +43,62 @@ void InputHandler::HandleKeyboard(const SDL_KeyboardEvent& event) {
       SDL_StartTextInput();
     }
 
-    std::string keyName = SDL_GetKeyName(key);
-    if (keyName.empty()) return;
+    const char* keyName = SDL_GetKeyName(key);
+    if (keyName == nullptr || *keyName == '\0') return;
 
-    std::ranges::transform(keyName, keyName.begin(), [](unsigned char c) {
-      return std::tolower(c);
-    });
-
-    std::string inputStr = "<";
+    // reused so keys don't allocate
+    auto& inputStr = keyBuffer;
+    inputStr = "<";
     if (mod & SDL_KMOD_CTRL) inputStr += "C-";
     if (mod & SDL_KMOD_ALT) inputStr += "M-";
     if (mod & SDL_KMOD_GUI) inputStr += "D-";
     if (mod & SDL_KMOD_SHIFT) inputStr += "S-";
-    inputStr += keyName + ">";
+    for (const char* c = keyName; *c != '\0'; c++) {
+      inputStr += char(std::tolower((unsigned char)*c));
+    }
+    inputStr += ">";
 
     // LOG_INFO("Key: {}", inputStr);
     nvim.Input(inputStr);
+
+    bool textMod = mod & (SDL_KMOD_CTRL | SDL_KMOD_ALT | SDL_KMOD_GUI);
+    if (key == SDLK_SPACE && !textMod) {
+      Predict(" ");
+    } else {
+      InterruptPrediction();
+    }
   }
 }
 
 void InputHandler::HandleTextInput(const SDL_TextInputEvent& event) {
   if (macOptAsAlt && (mod & SDL_KMOD_ALT)) return;
 
-  std::string inputStr = event.text;
+  std::string_view inputStr = event.text;
+  bool multiline = inputStr.find('\n') != std::string_view::npos;
+  if (inputStr.size() >= pasteThreshold || multiline) {
+    paste.PasteText(std::string(inputStr));
+    InterruptPrediction();
+    return;
+  }
   if (inputStr == " ") return;
   if (inputStr == "<") inputStr = "<lt>";
 
   // LOG_INFO("Text: {}", inputStr);
   nvim.Input(inputStr);
+  Predict(event.text);
+}
+
+void InputHandler::HandleDrop(const SDL_DropEvent& event) {
+  if (event.data == nullptr) return;
+  switch (event.type) {
+    case SDL_EVENT_DROP_TEXT:
+      paste.PasteText(event.data);
+      break;
+    case SDL_EVENT_DROP_FILE:
+      paste.PasteFile(event.data);
+      break;
+  }
+  InterruptPrediction();
 }
 
 void InputHandler::HandleMouseButton(const SDL_MouseButtonEvent& event) {
@@ -90,7 +119,7 @@ void InputHandler::HandleMouseButtonAndMotion(int state, glm::vec2 mousePos) {
   if (!mouseButton.has_value()) return;
 
   int button = *mouseButton;
-  std::string buttonStr;
+  std::string_view buttonStr;
   switch (button) {
     case SDL_BUTTON_LEFT: buttonStr = "left"; break;
     case SDL_BUTTON_MIDDLE: buttonStr = "middle"; break;
@@ -98,7 +127,7 @@ void InputHandler::HandleMouseButtonAndMotion(int state, glm::vec2 mousePos) {
     default: return;
   }
 
-  std::string actionStr;
+  std::string_view actionStr;
   switch (state) {
     case SDL_PRESSED: actionStr = "press"; break;
     case SDL_RELEASED: actionStr = "release"; break;
@@ -122,6 +151,7 @@ void InputHandler::HandleMouseButtonAndMotion(int state, glm::vec2 mousePos) {
   if (!multigrid) info.grid = 0;
 
   nvim.InputMouse(buttonStr, actionStr, modStr, info.grid, info.row, info.col);
+  InterruptPrediction();
 }
 
 void InputHandler::HandleMouseWheel(const SDL_MouseWheelEvent& event) {
@@ -139,6 +169,7 @@ void InputHandler::HandleMouseWheel(const SDL_MouseWheelEvent& event) {
     info = winManager.GetMouseInfo(*currGrid, mousePos);
   }
   if (!multigrid) info.grid = 0;
+  InterruptPrediction();
 
   double scrollSpeed = 1;
   double scrollUnit = 1 / scrollSpeed;
@@ -159,7 +190,7 @@ void InputHandler::HandleMouseWheel(const SDL_MouseWheelEvent& event) {
     yAccum += yAbs;
     yAccum = std::min(yAccum, 100.0);
 
-    std::string actionStr = ypositive ? "up" : "down";
+    std::string_view actionStr = ypositive ? "up" : "down";
     while (yAccum >= scrollUnit) {
       nvim.InputMouse("wheel", actionStr, modStr, info.grid, info.row, info.col);
       yAccum -= scrollUnit;
@@ -174,10 +205,22 @@ void InputHandler::HandleMouseWheel(const SDL_MouseWheelEvent& event) {
     xAccum += xAbs;
     xAccum = std::min(xAccum, 100.0);
 
-    std::string actionStr = xpositive ? "right" : "left";
+    std::string_view actionStr = xpositive ? "right" : "left";
     while (xAccum >= scrollUnit) {
       nvim.InputMouse("wheel", actionStr, modStr, info.grid, info.row, info.col);
       xAccum -= scrollUnit;
     }
   }
 }
+
+void InputHandler::Predict(std::string_view text) {
+  if (predictor == nullptr || !predictor->enabled) return;
+  predictor->Typed(text);
+  // render thread may be idle, prediction should show up right away
+  nvim.uiEvents.Wakeup();
+}
+
+void InputHandler::InterruptPrediction() {
+  if (predictor == nullptr || !predictor->enabled) return;
+  predictor->Interrupt();
+}
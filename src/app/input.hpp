@@ -1,9 +1,11 @@
 #pragma once
 
 #include "SDL_events.h"
+#include "editor/prediction.hpp"
 #include "editor/window.hpp"
 #include "glm/ext/vector_float2.hpp"
 #include "nvim/nvim.hpp"
+#include "app/paste.hpp"
 #include <optional>
 
 struct InputHandler {
@@ -16,6 +18,7 @@ struct InputHandler {
 
   // shared
   SDL_Keymod mod = SDL_KMOD_NONE;
+  std::string keyBuffer;
 
   // mouse related
   std::optional<int> mouseButton;
@@ -25,12 +28,24 @@ struct InputHandler {
   double xAccum = 0;
   int scrollDir = 0;
 
+  // text input this long (or multiline) is pasted instead of typed
+  static constexpr size_t pasteThreshold = 64;
+  PasteStreamer paste;
+
+  // local echo, told about every key so it knows when it can't predict
+  Predictor* predictor = nullptr;
+
   InputHandler(Nvim& nvim, WinManager& winManager, bool macOptAsAlt, bool multigrid);
 
   void HandleKeyboard(const SDL_KeyboardEvent& event);
   void HandleTextInput(const SDL_TextInputEvent& event);
+  void HandleDrop(const SDL_DropEvent& event);
   void HandleMouseButton(const SDL_MouseButtonEvent& event);
   void HandleMouseMotion(const SDL_MouseMotionEvent& event);
   void HandleMouseButtonAndMotion(int state, glm::vec2 pos);
   void HandleMouseWheel(const SDL_MouseWheelEvent& event);
+
+private:
+  void Predict(std::string_view text);
+  void InterruptPrediction();
 };
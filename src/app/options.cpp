@@ -1,21 +1,36 @@
 #include "options.hpp"
 #include "utils/logger.hpp"
 #include <format>
+#include <functional>
+#include <map>
+#include <vector>
 
-static void LoadOption(Nvim& nvim, std::string_view name, auto& value) {
+// queues option load into batch, value is set once the batch returns
+static void LoadOption(
+  Nvim::Batch& batch,
+  std::vector<std::function<void(const Nvim::BatchResults&)>>& loaders,
+  std::string_view name,
+  auto& value
+) {
+  using T = std::remove_cvref_t<decltype(value)>;
   auto luaCode = std::format("return vim.g.neogui_opts_resolved.{}", name);
-  msgpack::object_handle result = nvim.ExecLua(luaCode, {});
-  try {
-    value = result->convert();
-  } catch (const std::exception& e) {
-    LOG_ERR("Failed to load option {}: {}", name, e.what());
-  }
+  auto ref = batch.Add<T>("nvim_exec_lua", luaCode, std::vector<Nvim::VariantRef>{});
+  loaders.emplace_back([name, &value, ref](const Nvim::BatchResults& results) {
+    if (auto result = results.Get(ref)) {
+      value = *result;
+    } else {
+      LOG_ERR("Failed to load option {}", name);
+    }
+  });
 };
 
-#define LOAD(name) LoadOption(nvim, #name, name)
+#define LOAD(name) LoadOption(batch, loaders, #name, name)
 
 void Options::Load(Nvim& nvim) {
-  nvim.ExecLua("vim.g.resolve_neogui_opts()", {});
+  Nvim::Batch batch;
+  std::vector<std::function<void(const Nvim::BatchResults&)>> loaders;
+
+  batch.Add("nvim_exec_lua", "vim.g.resolve_neogui_opts()", std::vector<Nvim::VariantRef>{});
 
   LOAD(window.vsync);
   LOAD(window.highDpi);
@@ -35,6 +50,21 @@ void Options::Load(Nvim& nvim) {
   LOAD(transparency);
 
   LOAD(maxFps);
+  LOAD(predictiveEcho);
+
+  auto guifontRef = batch.Add<std::string>(
+    "nvim_get_option_value", "guifont", std::map<std::string_view, Nvim::VariantRef>{}
+  );
+
+  // whole config in a single round trip
+  auto results = nvim.ExecBatch(batch);
+  if (results.error) {
+    LOG_ERR("Options::Load: {}", *results.error);
+  }
+  for (auto& loader : loaders) {
+    loader(results);
+  }
+  guifont = results.Get(guifontRef).value_or("");
 
   transparency = int(transparency * 255) / 255.0f;
 }
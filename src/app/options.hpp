@@ -1,6 +1,7 @@
 #pragma once
 #include "nvim/nvim.hpp"
 #include <cstdint>
+#include <string>
 
 struct Options {
   struct Window {
@@ -27,5 +28,11 @@ struct Options {
 
   float maxFps;
 
+  // draw typed characters before nvim echoes them, see editor/prediction.hpp
+  bool predictiveEcho;
+
+  // vim option, fetched with the rest so startup is a single round trip
+  std::string guifont;
+
   void Load(Nvim& nvim);
 };
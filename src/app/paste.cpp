@@ -0,0 +1,208 @@
+#include "paste.hpp"
+#include "utils/logger.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+using namespace std::chrono;
+using namespace std::chrono_literals;
+
+PasteStreamer::PasteStreamer(Nvim& _nvim) : nvim(_nvim) {
+}
+
+PasteStreamer::~PasteStreamer() {
+  {
+    std::scoped_lock lock(mutex);
+    exit = true;
+    cv.notify_all();
+  }
+  {
+    std::scoped_lock lock(inFlight->mutex);
+    inFlight->cv.notify_all();
+  }
+  if (thread.joinable()) thread.join();
+}
+
+void PasteStreamer::PasteText(std::string&& text) {
+  Push({.text = std::move(text)});
+}
+
+void PasteStreamer::PasteFile(std::string&& path) {
+  Push({.path = std::move(path)});
+}
+
+PasteStreamer::Stats PasteStreamer::GetStats() {
+  std::scoped_lock lock(statsMutex);
+  return stats;
+}
+
+void PasteStreamer::Push(Job&& job) {
+  std::scoped_lock lock(mutex);
+  // started on first use, most sessions never paste anything big
+  if (!thread.joinable()) {
+    thread = std::thread([this] { Run(); });
+  }
+  jobs.push_back(std::move(job));
+  cv.notify_one();
+}
+
+void PasteStreamer::Run() {
+  while (true) {
+    Job job;
+    {
+      std::unique_lock lock(mutex);
+      cv.wait(lock, [&] { return exit || !jobs.empty(); });
+      if (exit) return;
+      job = std::move(jobs.front());
+      jobs.pop_front();
+    }
+    Stream(job);
+  }
+}
+
+// end of chunk that doesn't cut a utf-8 sequence or a \r\n pair
+static size_t SafeSplit(std::string_view data) {
+  size_t end = data.size();
+  for (size_t i = 1; i <= 4 && i <= end; i++) {
+    auto b = static_cast<uint8_t>(data[end - i]);
+    if ((b & 0xc0) == 0x80) continue;
+    size_t length = b < 0x80 ? 1 : b >= 0xf0 ? 4 : b >= 0xe0 ? 3 : 2;
+    if (length > i) end -= i;
+    break;
+  }
+  if (end > 0 && data[end - 1] == '\r') end--;
+  return end;
+}
+
+void PasteStreamer::Stream(Job& job) {
+  std::ifstream file;
+  if (!job.path.empty()) {
+    file.open(job.path, std::ios::binary);
+    if (!file) {
+      LOG_ERR("PasteStreamer: Failed to open {}", job.path);
+      return;
+    }
+  }
+
+  // appends up to a full chunk, returns false once the source is exhausted
+  size_t textOffset = 0;
+  auto fill = [&](std::string& chunk) {
+    size_t size = chunk.size();
+    chunk.resize(chunkSize);
+    size_t length;
+    if (file.is_open()) {
+      file.read(chunk.data() + size, chunkSize - size);
+      length = file.gcount();
+    } else {
+      length = std::min(chunkSize - size, job.text.size() - textOffset);
+      std::memcpy(chunk.data() + size, job.text.data() + textOffset, length);
+      textOffset += length;
+    }
+    chunk.resize(size + length);
+    return file.is_open() ? file.peek() != EOF : textOffset < job.text.size();
+  };
+
+  {
+    std::scoped_lock lock(inFlight->mutex);
+    inFlight->cancelled = false;
+  }
+
+  auto start = steady_clock::now();
+  size_t bytes = 0;
+  size_t chunks = 0;
+  std::string chunk;
+  std::string carry; // bytes cut off the end of the previous chunk
+  bool first = true;
+  while (true) {
+    chunk.swap(carry);
+    carry.clear();
+    bool last = !fill(chunk);
+    if (!last) {
+      size_t end = SafeSplit(chunk);
+      carry.assign(chunk, end);
+      chunk.resize(end);
+    }
+
+    if (!WaitForRoom()) {
+      // nvim already ended a cancelled paste, otherwise end it ourselves
+      bool cancelled;
+      {
+        std::scoped_lock lock(inFlight->mutex);
+        cancelled = inFlight->cancelled;
+      }
+      if (!first && !cancelled) SendChunk("", 3);
+      LOG_INFO("PasteStreamer: Paste stopped after {} bytes", bytes);
+      break;
+    }
+
+    // -1 single chunk, 1 first, 2 continue, 3 last
+    int phase = first ? (last ? -1 : 1) : (last ? 3 : 2);
+    SendChunk(chunk, phase);
+    bytes += chunk.size();
+    chunks++;
+    first = false;
+    if (last) break;
+  }
+
+  auto elapsed = steady_clock::now() - start;
+  double seconds = duration<double>(elapsed).count();
+  LOG_INFO(
+    "PasteStreamer: {} KB in {} chunks, {}ms ({:.1f} MB/s)", bytes >> 10, chunks,
+    duration_cast<milliseconds>(elapsed).count(),
+    seconds > 0 ? bytes / seconds / (1 << 20) : 0.0
+  );
+
+  std::scoped_lock lock(statsMutex);
+  stats.pastes++;
+  stats.chunks += chunks;
+  stats.bytes += bytes;
+  stats.time += elapsed;
+}
+
+bool PasteStreamer::WaitForRoom() {
+  bool waited = false;
+
+  // writer queue, so a paste can't bury keystrokes behind megabytes of data
+  while (!nvim.client.WaitWriteQueue(maxQueuedBytes, 100ms)) {
+    waited = true;
+    if (exit) return false;
+  }
+  if (!nvim.IsConnected()) return false;
+
+  // unanswered chunks, so we don't outrun nvim itself
+  {
+    std::unique_lock lock(inFlight->mutex);
+    if (inFlight->count >= maxChunksInFlight) waited = true;
+    inFlight->cv.wait(lock, [&] {
+      return inFlight->count < maxChunksInFlight || inFlight->cancelled || exit;
+    });
+    if (inFlight->cancelled || exit) return false;
+  }
+
+  if (waited) {
+    std::scoped_lock lock(statsMutex);
+    stats.waits++;
+  }
+  return true;
+}
+
+void PasteStreamer::SendChunk(std::string_view chunk, int phase) {
+  {
+    std::scoped_lock lock(inFlight->mutex);
+    inFlight->count++;
+  }
+
+  // crlf = true, nvim turns \r\n into \n
+  auto call = nvim.Call("nvim_paste", chunk, true, phase);
+  std::move(call).Then([inFlight = inFlight](rpc::Result result) {
+    std::scoped_lock lock(inFlight->mutex);
+    inFlight->count--;
+    // false means stop pasting (like the user pressing <C-c>)
+    const auto* obj = result ? &result->get() : nullptr;
+    if (!obj || obj->type != msgpack::type::BOOLEAN || !obj->via.boolean) {
+      inFlight->cancelled = true;
+    }
+    inFlight->cv.notify_all();
+  });
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "nvim/nvim.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Streams large text pastes and file drops into nvim with nvim_paste,
+// in chunks on a background thread so the event loop never blocks.
+// Pastes run one at a time in the order they were queued.
+struct PasteStreamer {
+  static constexpr size_t chunkSize = 1 << 20;
+  // wait when the writer has this much queued, or this many chunks are unanswered
+  static constexpr size_t maxQueuedBytes = 4 << 20;
+  static constexpr size_t maxChunksInFlight = 4;
+
+  struct Stats {
+    size_t pastes;
+    size_t chunks;
+    size_t bytes;
+    size_t waits; // times a chunk waited on backpressure
+    std::chrono::nanoseconds time;
+  };
+
+  PasteStreamer(Nvim& nvim);
+  PasteStreamer(const PasteStreamer&) = delete;
+  PasteStreamer& operator=(const PasteStreamer&) = delete;
+  ~PasteStreamer();
+
+  void PasteText(std::string&& text);
+  void PasteFile(std::string&& path);
+  Stats GetStats();
+
+private:
+  struct Job {
+    std::string text;
+    std::string path; // read from file if set
+  };
+
+  Nvim& nvim;
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<Job> jobs;
+  std::atomic_bool exit = false;
+
+  // chunks sent but not answered yet, and whether the paste should stop.
+  // shared with response handlers, which can outlive the streamer
+  struct InFlight {
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t count = 0;
+    bool cancelled = false;
+  };
+  std::shared_ptr<InFlight> inFlight = std::make_shared<InFlight>();
+
+  std::mutex statsMutex;
+  Stats stats{};
+
+  void Push(Job&& job);
+  void Run();
+  void Stream(Job& job);
+  // waits for backpressure, returns false if the paste should stop
+  bool WaitForRoom();
+  void SendChunk(std::string_view chunk, int phase);
+};
@@ -1,4 +1,6 @@
 #include "sdl_event.hpp"
+#include <future>
+#include <memory>
 
 namespace sdl {
 
@@ -16,4 +18,37 @@ void AddEventWatch(EventFilter&& callback) {
   SDL_AddEventWatch(filter, &userData);
 }
 
+struct MainThreadTask {
+  std::function<void()> func;
+  std::promise<void> done;
+};
+static TSQueue<std::shared_ptr<MainThreadTask>> mainThreadTasks;
+
+uint32_t MainThreadEvent() {
+  static uint32_t type = SDL_RegisterEvents(1);
+  return type;
+}
+
+bool RunOnMainThread(std::function<void()>&& func, std::chrono::milliseconds timeout) {
+  auto task = std::make_shared<MainThreadTask>();
+  task->func = std::move(func);
+  auto done = task->done.get_future();
+  mainThreadTasks.Push(task);
+
+  SDL_Event event{};
+  event.type = MainThreadEvent();
+  SDL_PushEvent(&event);
+
+  return done.wait_for(timeout) == std::future_status::ready;
+}
+
+void RunMainThreadTasks() {
+  while (!mainThreadTasks.Empty()) {
+    auto task = std::move(mainThreadTasks.Front());
+    mainThreadTasks.Pop();
+    task->func();
+    task->done.set_value();
+  }
+}
+
 } // namespace sdl
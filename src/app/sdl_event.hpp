@@ -5,10 +5,22 @@
 #include <vector>
 #include <functional>
 #include <utility>
+#include <chrono>
 
 namespace sdl {
 
 using EventFilter = std::function<void(SDL_Event&)>;
 void AddEventWatch(EventFilter&& callback);
 
+// For SDL calls that must happen on the main thread (clipboard).
+// Queues func for the event loop and waits until it has run.
+// Returns false on timeout, func still runs later so capture by value.
+bool RunOnMainThread(
+  std::function<void()>&& func,
+  std::chrono::milliseconds timeout = std::chrono::milliseconds(1000)
+);
+// event type that wakes the event loop, handle it with RunMainThreadTasks()
+uint32_t MainThreadEvent();
+void RunMainThreadTasks();
+
 } // namespace sdl
@@ -0,0 +1,59 @@
+#include "session.hpp"
+
+#include "app/clipboard.hpp"
+#include "utils/color.hpp"
+
+Session::Session(
+  std::string _name,
+  std::unique_ptr<Nvim>&& _nvim,
+  const Options& options,
+  const SizeHandler& sizes
+)
+    : name(std::move(_name)), nvim(std::move(_nvim)),
+      editorState{
+        .winManager{.sizes = sizes},
+        .cursor{.fullSize = sizes.charSize},
+      },
+      input(*nvim, editorState.winManager, options.macOptAsAlt, options.multigrid) {
+  editorState.winManager.gridManager = &editorState.gridManager;
+  if (options.transparency < 1) {
+    auto& hl = editorState.hlTable[0];
+    hl.background = IntToColor(options.bgColor);
+    hl.background->a = options.transparency;
+  }
+
+  editorState.predictor.enabled = options.predictiveEcho;
+  input.predictor = &editorState.predictor;
+
+  RegisterClipboard(nvim->client);
+  nvim->client.RegisterHandler(
+    "prediction_stats",
+    [this](const msgpack::object&, rpc::Reply& reply) {
+      reply.Result(editorState.predictor.DumpStats());
+    }
+  );
+
+  nvim->UiAttach(
+    sizes.uiWidth, sizes.uiHeight,
+    {
+      {"rgb", true},
+      {"ext_multigrid", options.multigrid},
+      {"ext_linegrid", true},
+    }
+  );
+}
+
+Session::~Session() {
+  // editorState goes away before nvim does, and a prediction_stats
+  // request may already be queued on the workers
+  nvim->client.Disconnect();
+  nvim->client.StopHandlers();
+}
+
+void Session::Detach() {
+  if (!nvim->IsConnected()) return;
+  // send escape so nvim doesn't get stuck when reattaching
+  // prevents cmd + q exiting window getting stuck
+  nvim->Input("<Esc>");
+  nvim->UiDetach();
+}
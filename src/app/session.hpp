@@ -0,0 +1,33 @@
+#pragma once
+
+#include "app/input.hpp"
+#include "app/options.hpp"
+#include "app/size.hpp"
+#include "editor/state.hpp"
+#include "nvim/nvim.hpp"
+#include <memory>
+#include <string>
+
+// An attached nvim and everything parsed from it.
+// Sessions share the window, gpu device, fonts and renderer,
+// so switching between them only changes which editor state is drawn.
+struct Session {
+  std::string name;
+  std::unique_ptr<Nvim> nvim;
+  EditorState editorState;
+  InputHandler input;
+
+  // attaches the ui, nvim must be connected
+  Session(
+    std::string name,
+    std::unique_ptr<Nvim>&& nvim,
+    const Options& options,
+    const SizeHandler& sizes
+  );
+  Session(const Session&) = delete;
+  Session& operator=(const Session&) = delete;
+  ~Session();
+
+  // detaches the ui if nvim is still around
+  void Detach();
+};
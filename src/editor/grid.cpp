@@ -69,10 +69,12 @@ void GridManager::Line(const GridLine& e) {
   auto& line = grid.lines[e.row];
   int col = e.colStart;
   for (const auto& cell : e.cells) {
+    uint32_t charcode = UTF8ToUnicode(cell.text);
     for (int i = 0; i < cell.repeat; i++) {
       auto& lineCell = line[col];
       lineCell.text = cell.text;
       lineCell.hlId = cell.hlId;
+      lineCell.charcode = charcode;
       col++;
     }
   }
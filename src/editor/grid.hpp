@@ -2,6 +2,9 @@
 
 #include "nvim/events/parse.hpp"
 #include "utils/ring_buffer.hpp"
+#include "utils/unicode.hpp"
+#include <cstdint>
+#include <string_view>
 #include <vector>
 
 struct Win; // forward decl
@@ -16,6 +19,12 @@ struct Grid {
   struct Cell {
     std::string text;
     int hlId = 0;
+    // first codepoint of text, decoded once here instead of every frame
+    uint32_t charcode = ' ';
+
+    Cell(std::string_view _text = " ", int _hlId = 0)
+        : text(_text), hlId(_hlId), charcode(UTF8ToUnicode(_text)) {
+    }
   };
   using Line = std::vector<Cell>;
   using Lines = RingBuffer<Line>;
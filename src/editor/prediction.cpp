@@ -0,0 +1,243 @@
+#include "prediction.hpp"
+
+#include <algorithm>
+#include <format>
+
+using namespace std::chrono;
+
+void Predictor::Typed(std::string_view text) {
+  if (!enabled) return;
+  // wide and combining characters would need cell widths, don't guess
+  bool printable = text.size() == 1 && text[0] >= 0x20 && text[0] < 0x7f;
+  if (!printable) {
+    Interrupt();
+    return;
+  }
+  std::scoped_lock lock(keysMutex);
+  keys.push_back({std::string(text), Clock::now()});
+}
+
+void Predictor::Interrupt() {
+  if (!enabled) return;
+  std::scoped_lock lock(keysMutex);
+  keys.push_back({{}, Clock::now()});
+}
+
+void Predictor::ModeChange(std::string_view mode) {
+  // predictions left over are rolled back on flush
+  insertMode = mode == "insert";
+}
+
+void Predictor::CursorGoto(const GridCursorGoto& e) {
+  cursorGrid = e.grid;
+  cursorRow = e.row;
+  cursorCol = e.col;
+}
+
+void Predictor::BeforeLine(GridManager& gridManager, const GridLine& e) {
+  if (drawn && e.grid == grid && e.row == row) {
+    Restore(gridManager);
+  }
+}
+
+void Predictor::BeforeGridChange(GridManager& gridManager, int _grid) {
+  if (predictions.empty() || _grid != grid) return;
+  // rows are moving around, not worth tracking
+  auto now = Clock::now();
+  Restore(gridManager);
+  Discard(now, false);
+  Pause(now);
+}
+
+void Predictor::Flush(GridManager& gridManager) {
+  auto now = Clock::now();
+  if (predictions.empty()) {
+    if (paused && now >= resumeTime) paused = false;
+    return;
+  }
+
+  auto* g = FindGrid(gridManager);
+  if (g == nullptr) {
+    Discard(now, false);
+    drawn = false;
+    return;
+  }
+  // nvim redrew the row, so its version is the new snapshot
+  if (!drawn) snapshot = g->lines[row];
+
+  bool onRow = insertMode && cursorGrid == grid && cursorRow == row;
+  while (!predictions.empty()) {
+    auto& p = predictions.front();
+    if (!onRow) {
+      Discard(now, false);
+      Pause(now);
+      break;
+    }
+    // nvim hasn't got to this key yet
+    if (cursorCol <= p.col) break;
+
+    if (snapshot[p.col].text != p.text) {
+      Discard(now, false);
+      Pause(now);
+      break;
+    }
+
+    auto rtt = now - p.typed;
+    srtt = srtt * 7 / 8 + rtt / 8;
+    {
+      std::scoped_lock lock(statsMutex);
+      stats.confirmed++;
+      stats.roundTrip.Record(rtt);
+      stats.perceived.Record(p.shown - p.typed);
+    }
+    predictions.pop_front();
+  }
+
+  Draw(gridManager);
+}
+
+bool Predictor::Update(GridManager& gridManager) {
+  std::vector<Key> newKeys;
+  {
+    std::scoped_lock lock(keysMutex);
+    newKeys.swap(keys);
+  }
+
+  auto now = Clock::now();
+  bool changed = false;
+
+  if (!predictions.empty() && now - predictions.front().typed > timeout) {
+    Discard(now, true);
+    Pause(now);
+    changed = true;
+  }
+
+  for (auto& key : newKeys) {
+    if (key.text.empty()) {
+      Pause(key.time);
+      continue;
+    }
+    if (paused && predictions.empty() && key.time >= resumeTime) {
+      paused = false;
+    }
+
+    Grid* g = nullptr;
+    if (insertMode && !paused) {
+      if (predictions.empty()) {
+        grid = cursorGrid;
+        row = cursorRow;
+      }
+      g = FindGrid(gridManager);
+    }
+    int col = predictions.empty() ? cursorCol : predictions.back().col + 1;
+    // stay on nvim's cursor row and don't predict line wraps
+    if (g == nullptr || grid != cursorGrid || row != cursorRow || col >= g->width - 1) {
+      {
+        std::scoped_lock lock(statsMutex);
+        stats.skipped++;
+      }
+      // the cursor is stale until nvim echoes this key
+      Pause(key.time);
+      continue;
+    }
+
+    if (predictions.empty()) snapshot = g->lines[row];
+    predictions.push_back({col, std::move(key.text), key.time, now});
+    {
+      std::scoped_lock lock(statsMutex);
+      stats.predicted++;
+    }
+    changed = true;
+  }
+
+  if (changed) Draw(gridManager);
+  return changed;
+}
+
+Predictor::Stats Predictor::GetStats() {
+  std::scoped_lock lock(statsMutex);
+  return stats;
+}
+
+static double Ms(nanoseconds time) {
+  return duration<double, std::milli>(time).count();
+}
+
+std::string Predictor::DumpStats() {
+  auto s = GetStats();
+  size_t resolved = s.confirmed + s.rolledBack + s.expired;
+  double hitRate = resolved > 0 ? 100.0 * s.confirmed / resolved : 0.0;
+
+  std::string out = std::format(
+    "prediction: {} predicted, {} confirmed, {} rolled back, {} expired, {} skipped, "
+    "hit rate {:.1f}%\n",
+    s.predicted, s.confirmed, s.rolledBack, s.expired, s.skipped, hitRate
+  );
+  out += std::format(
+    "round trip  mean {:.1f}ms p50 {:.1f}ms p99 {:.1f}ms max {:.1f}ms\n",
+    Ms(s.roundTrip.Mean()), Ms(s.roundTrip.Percentile(0.5)),
+    Ms(s.roundTrip.Percentile(0.99)), Ms(s.roundTrip.max)
+  );
+  out += std::format(
+    "perceived   mean {:.1f}ms p50 {:.1f}ms p99 {:.1f}ms max {:.1f}ms\n",
+    Ms(s.perceived.Mean()), Ms(s.perceived.Percentile(0.5)),
+    Ms(s.perceived.Percentile(0.99)), Ms(s.perceived.max)
+  );
+  return out;
+}
+
+Grid* Predictor::FindGrid(GridManager& gridManager) {
+  auto it = gridManager.grids.find(grid);
+  if (it == gridManager.grids.end()) return nullptr;
+  if (row < 0 || row >= it->second.height) return nullptr;
+  return &it->second;
+}
+
+void Predictor::Restore(GridManager& gridManager) {
+  if (!drawn) return;
+  drawn = false;
+  auto* g = FindGrid(gridManager);
+  if (g == nullptr) return;
+  g->lines[row] = snapshot;
+  g->dirty = true;
+}
+
+void Predictor::Draw(GridManager& gridManager) {
+  auto* g = FindGrid(gridManager);
+  if (g == nullptr) return;
+  if (!drawn && predictions.empty()) return;
+
+  auto& line = g->lines[row];
+  line = snapshot;
+  // typing in insert mode pushes the rest of the line right
+  for (auto& p : predictions) {
+    std::move_backward(line.begin() + p.col, line.end() - 1, line.end());
+    int hlId = p.col > 0 ? line[p.col - 1].hlId : line[p.col].hlId;
+    line[p.col] = {p.text, hlId};
+  }
+
+  if (!predictions.empty()) {
+    g->cursorRow = row;
+    g->cursorCol = predictions.back().col + 1;
+  } else if (cursorGrid == grid) {
+    g->cursorRow = cursorRow;
+    g->cursorCol = cursorCol;
+  }
+  g->dirty = true;
+  drawn = !predictions.empty();
+}
+
+void Predictor::Discard(Clock::time_point now, bool expired) {
+  std::scoped_lock lock(statsMutex);
+  for (auto& p : predictions) {
+    (expired ? stats.expired : stats.rolledBack)++;
+    // the correct text shows up now
+    stats.perceived.Record(now - p.typed);
+  }
+  predictions.clear();
+}
+
+void Predictor::Pause(Clock::time_point now) {
+  paused = true;
+  resumeTime = std::max(resumeTime, now + srtt * 2);
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "editor/grid.hpp"
+#include "nvim/events/ui.hpp"
+#include "nvim/msgpack_rpc/metrics.hpp"
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Mosh style local echo for slow connections.
+// Printable characters typed in insert mode are drawn at the cursor straight
+// away, then confirmed or rolled back once nvim's own redraw of the row arrives.
+// Anything that can't be predicted (special keys, mouse, pastes) pauses
+// predictions until nvim has caught up.
+//
+// Typed() and Interrupt() are called from the event loop,
+// everything else from the render thread.
+struct Predictor {
+  using Clock = std::chrono::steady_clock;
+
+  // unconfirmed predictions are rolled back after this long
+  static constexpr std::chrono::milliseconds timeout{1000};
+
+  bool enabled = false;
+
+  // event loop ------------------------------------
+  void Typed(std::string_view text);
+  void Interrupt();
+
+  // render thread ---------------------------------
+  // nvim events, call before the grid manager handles them
+  void ModeChange(std::string_view mode);
+  void CursorGoto(const GridCursorGoto& e);
+  void BeforeLine(GridManager& gridManager, const GridLine& e);
+  // scroll, clear, resize and destroy
+  void BeforeGridChange(GridManager& gridManager, int grid);
+  // checks predictions against the flushed grid and redraws the ones left
+  void Flush(GridManager& gridManager);
+
+  // draws newly typed characters and expires old predictions,
+  // returns true if the grid changed
+  bool Update(GridManager& gridManager);
+
+  struct Stats {
+    size_t predicted;
+    size_t confirmed;
+    size_t rolledBack; // nvim drew something else
+    size_t expired;    // nvim never drew it
+    size_t skipped;    // typed while paused or outside insert mode
+    // key press to nvim drawing the character
+    rpc::LatencyHistogram roundTrip;
+    // key press to the correct character on screen, predicted or not
+    rpc::LatencyHistogram perceived;
+  };
+  Stats GetStats();
+  std::string DumpStats();
+
+private:
+  struct Key {
+    std::string text; // empty for an interrupt
+    Clock::time_point time;
+  };
+  std::mutex keysMutex;
+  std::vector<Key> keys;
+
+  struct Prediction {
+    int col;
+    std::string text;
+    Clock::time_point typed;
+    Clock::time_point shown;
+  };
+  // predictions are only made on one row at a time,
+  // snapshot is nvim's version of it
+  int grid = -1;
+  int row = -1;
+  Grid::Line snapshot;
+  std::deque<Prediction> predictions;
+  // the grid row currently has predicted cells in it
+  bool drawn = false;
+
+  // nvim's cursor, the grid's cursor is moved to the end of the predictions
+  int cursorGrid = -1;
+  int cursorRow = 0;
+  int cursorCol = 0;
+
+  bool insertMode = false;
+  bool paused = false;
+  Clock::time_point resumeTime;
+  // smoothed round trip, pauses last a couple of these
+  std::chrono::nanoseconds srtt{std::chrono::milliseconds(100)};
+
+  std::mutex statsMutex;
+  Stats stats{};
+
+  Grid* FindGrid(GridManager& gridManager);
+  // writes the snapshot back into the grid
+  void Restore(GridManager& gridManager);
+  // snapshot plus predictions into the grid
+  void Draw(GridManager& gridManager);
+  // drops all predictions, counting them as rolled back or expired
+  void Discard(Clock::time_point now, bool expired);
+  void Pause(Clock::time_point now);
+};
@@ -14,7 +14,7 @@ static int VariantAsInt(const msgpack::type::variant& v) {
   return 0;
 }
 
-static const auto gridTypes = vIndicesSet<
+[[maybe_unused]] static constexpr auto gridTypes = vIndicesMask<
   UiEvent,
   GridResize,
   GridClear,
@@ -25,7 +25,7 @@ static const auto gridTypes = vIndicesSet<
 
 // doesn't include MsgSetPos, and WinViewportMargins, cuz they should run after
 // all the other win events
-static const auto winTypes = vIndicesSet<
+static constexpr auto winTypes = vIndicesMask<
   UiEvent,
   WinPos,
   WinFloatPos,
@@ -34,22 +34,37 @@ static const auto winTypes = vIndicesSet<
   WinClose,
   WinViewport>();
 
+// later ones win if a highlight has several
+static constexpr std::pair<HlAttrDefine::Attr, UnderlineType> underlineTypes[] = {
+  {HlAttrDefine::Underline, UnderlineType::Underline},
+  {HlAttrDefine::Undercurl, UnderlineType::Undercurl},
+  {HlAttrDefine::Underdouble, UnderlineType::Underdouble},
+  {HlAttrDefine::Underdotted, UnderlineType::Underdotted},
+  {HlAttrDefine::Underdashed, UnderlineType::Underdashed},
+};
+
 // clang-format off
 // i hate clang format on std::visit(overloaded{})
 bool ParseEditorState(UiEvents& uiEvents, EditorState& editorState) {
-  bool processedEvents = uiEvents.numFlushes > 0;
-  for (int i = 0; i < uiEvents.numFlushes; i++) {
-    auto& redrawEvents = uiEvents.queue.front();
+  // flushes decoded after this are applied next frame
+  size_t numFlushes = uiEvents.NumFlushes();
+  bool processedEvents = numFlushes > 0;
+  // occasionally win events are sent before grid events
+  // so just handle manually
+  // (kept across calls so their capacity is reused)
+  static thread_local std::vector<UiEventRef> winEvents;
+  // neovim sends these events before appropriate window is created
+  static thread_local std::vector<WinViewportMargins*> margins;
+  static thread_local std::vector<MsgSetPos*> msgSetPos;
 
-    // occasionally win events are sent before grid events
-    // so just handle manually
-    std::vector<UiEvent*> winEvents;
-    // neovim sends these events before appropriate window is created
-    std::vector<WinViewportMargins*> margins;
-    std::vector<MsgSetPos*> msgSetPos;
+  for (size_t i = 0; i < numFlushes; i++) {
+    auto& redrawEvents = uiEvents.Front().events;
+    winEvents.clear();
+    margins.clear();
+    msgSetPos.clear();
 
-    for (auto& event : redrawEvents) {
-      std::visit(overloaded{
+    for (auto event : redrawEvents) {
+      Visit(overloaded{
         [&](SetTitle& e) {
           // LOG("set_title");
         },
@@ -110,6 +125,7 @@ bool ParseEditorState(UiEvents& uiEvents, EditorState& editorState) {
         },
         [&](ModeChange& e) {
           editorState.cursor.SetMode(&editorState.modeInfoList[e.modeIdx]);
+          editorState.predictor.ModeChange(e.mode);
         },
         [&](MouseOn&) {
           // LOG("mouse_on");
@@ -143,38 +159,20 @@ bool ParseEditorState(UiEvents& uiEvents, EditorState& editorState) {
         },
         [&](HlAttrDefine& e) {
           // LOG("hl_attr_define");
+          // a define replaces the whole entry, attrs it leaves out are off
           auto& hl = editorState.hlTable[e.id];
-          for (auto& [key, value] : e.rgbAttrs) {
-            if (key == "foreground") {
-              hl.foreground = IntToColor(VariantAsInt(value));
-            } else if (key == "background") {
-              hl.background = IntToColor(VariantAsInt(value));
-            } else if (key == "special") {
-              hl.special = IntToColor(VariantAsInt(value));
-            } else if (key == "reverse") {
-              hl.reverse = value.as_bool();
-            } else if (key == "italic") {
-              hl.italic = value.as_bool();
-            } else if (key == "bold") {
-              hl.bold = value.as_bool();
-            } else if (key == "strikethrough") {
-              hl.strikethrough = value.as_bool();
-            } else if (key == "underline") {
-              hl.underline = UnderlineType::Underline;
-            } else if (key == "undercurl") {
-              hl.underline = UnderlineType::Undercurl;
-            } else if (key == "underdouble") {
-              hl.underline = UnderlineType::Underdouble;
-            } else if (key == "underdotted") {
-              hl.underline = UnderlineType::Underdotted;
-            } else if (key == "underdashed") {
-              hl.underline = UnderlineType::Underdashed;
-            } else if (key == "blend") {
-              hl.bgAlpha = 1 - (VariantAsInt(value) / 100.0f);
-            } else {
-              LOG_WARN("unknown hl attr key: {}", key);
-            }
+          hl = {};
+          if (e.Has(HlAttrDefine::Foreground)) hl.foreground = IntToColor(e.foreground);
+          if (e.Has(HlAttrDefine::Background)) hl.background = IntToColor(e.background);
+          if (e.Has(HlAttrDefine::Special)) hl.special = IntToColor(e.special);
+          hl.reverse = e.Has(HlAttrDefine::Reverse);
+          hl.italic = e.Has(HlAttrDefine::Italic);
+          hl.bold = e.Has(HlAttrDefine::Bold);
+          hl.strikethrough = e.Has(HlAttrDefine::Strikethrough);
+          for (auto [attr, type] : underlineTypes) {
+            if (e.Has(attr)) hl.underline = type;
           }
+          if (e.Has(HlAttrDefine::Blend)) hl.bgAlpha = 1 - (e.blend / 100.0f);
         },
         [&](HlGroupSet& e) {
           // not needed to render grids, but used for rendering
@@ -182,6 +180,7 @@ bool ParseEditorState(UiEvents& uiEvents, EditorState& editorState) {
           // editorState.hlGroupTable.emplace(e.id, e.name);
         },
         [&](GridResize& e) {
+          editorState.predictor.BeforeGridChange(editorState.gridManager, e.grid);
           editorState.gridManager.Resize(e);
           // default window events not send by nvim
           if (e.grid == 1) {
@@ -189,32 +188,37 @@ bool ParseEditorState(UiEvents& uiEvents, EditorState& editorState) {
           }
         },
         [&](GridClear& e) {
+          editorState.predictor.BeforeGridChange(editorState.gridManager, e.grid);
           editorState.gridManager.Clear(e);
         },
         [&](GridCursorGoto& e) {
+          editorState.predictor.CursorGoto(e);
           editorState.gridManager.CursorGoto(e);
           editorState.winManager.activeWinId = e.grid;
         },
         [&](GridLine& e) {
+          editorState.predictor.BeforeLine(editorState.gridManager, e);
           editorState.gridManager.Line(e);
         },
         [&](GridScroll& e) {
+          editorState.predictor.BeforeGridChange(editorState.gridManager, e.grid);
           editorState.gridManager.Scroll(e);
         },
         [&](GridDestroy& e) {
+          editorState.predictor.BeforeGridChange(editorState.gridManager, e.grid);
           editorState.gridManager.Destroy(e);
           // TODO: file bug report, win_close not called after tabclose
           // temp fix for bug
           editorState.winManager.Close({e.grid});
         },
         [&](Flush&) {
-          if (redrawEvents.size() <= 1 && uiEvents.numFlushes == 1) {
+          if (redrawEvents.size() <= 1 && numFlushes == 1) {
             processedEvents = false;
           }
 
           // DONT REMOVE, win events should always execute last!
-          for (auto& event : winEvents) {
-            std::visit(overloaded{
+          for (auto winEvent : winEvents) {
+            Visit(overloaded{
               [&](WinPos& e) {
                 editorState.winManager.Pos(e);
               },
@@ -243,7 +247,7 @@ bool ParseEditorState(UiEvents& uiEvents, EditorState& editorState) {
               [&](auto&) {
                 LOG_WARN("unknown event");
               }
-            }, *event);
+            }, winEvent);
           }
           // apply margins and msg_set_pos after all events
           for (auto* e : margins) {
@@ -252,6 +256,9 @@ bool ParseEditorState(UiEvents& uiEvents, EditorState& editorState) {
           for (auto* e : msgSetPos) {
             editorState.winManager.MsgSet(*e);
           }
+
+          // grids are up to date, check what nvim made of the predictions
+          editorState.predictor.Flush(editorState.gridManager);
         },
         [&](MsgSetPos& e) {
           LOG("MsgSetPos: {}", e.grid);
@@ -261,10 +268,9 @@ bool ParseEditorState(UiEvents& uiEvents, EditorState& editorState) {
           LOG("WinViewportMargins: {}", e.grid);
           margins.push_back(&e);
         },
-        [&](auto& _e) {
-          auto* e = (UiEvent*)&_e;
-          if (winTypes.contains(e->index())) {
-            winEvents.push_back(e);
+        [&](auto&) {
+          if (vMaskContains(winTypes, event.tag)) {
+            winEvents.push_back(event);
             return;
           }
 
@@ -272,7 +278,7 @@ bool ParseEditorState(UiEvents& uiEvents, EditorState& editorState) {
         }
       }, event);
     }
-    uiEvents.queue.pop_front();
+    uiEvents.PopFront();
   }
 
   return processedEvents;
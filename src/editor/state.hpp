@@ -3,6 +3,7 @@
 #include "editor/cursor.hpp"
 #include "editor/grid.hpp"
 #include "editor/highlight.hpp"
+#include "editor/prediction.hpp"
 #include "editor/ui_options.hpp"
 #include "editor/window.hpp"
 #include "nvim/events/parse.hpp"
@@ -17,6 +18,8 @@ struct EditorState {
   HlTable hlTable;
   Cursor cursor;
   std::vector<ModeInfo> modeInfoList;
+  // local echo drawn over the grids, off unless enabled
+  Predictor predictor;
   // std::map<int, std::string> hlGroupTable;
 };
 
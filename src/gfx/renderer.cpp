@@ -144,7 +144,7 @@ void Renderer::RenderWindow(Win& win, FontFamily& fontFamily, const HlTable& hlT
     textOffset.x = 0;
 
     for (auto& cell : line) {
-      auto charcode = UTF8ToUnicode(cell.text);
+      auto charcode = cell.charcode;
       Highlight hl = hlTable.at(cell.hlId);
 
       // don't render background if default
@@ -5,6 +5,7 @@
 #include "app/sdl_window.hpp"
 #include "app/sdl_event.hpp"
 #include "app/options.hpp"
+#include "app/session.hpp"
 #include "editor/grid.hpp"
 #include "editor/highlight.hpp"
 #include "editor/state.hpp"
@@ -27,6 +28,14 @@
 #include <iostream>
 #include <format>
 #include <chrono>
+#include <future>
+#include <cstdlib>
+#include <optional>
+#include <utility>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
 
 using namespace wgpu;
 using namespace std::chrono_literals;
@@ -34,7 +43,62 @@ using namespace std::chrono;
 
 const WGPUContext& ctx = sdl::Window::_ctx;
 
-int main() {
+// peak resident memory in bytes, 0 where unsupported
+static size_t PeakRss() {
+#ifndef _WIN32
+  rusage usage{};
+  if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+  return usage.ru_maxrss;
+#else
+  return usage.ru_maxrss * 1024;
+#endif
+#else
+  return 0;
+#endif
+}
+
+int main(int argc, char** argv) {
+  // --capture <file>  record the inbound rpc stream
+  // --replay <file>   replay a capture instead of running nvim
+  // --replay-fast     replay as fast as possible instead of at original pace
+  // --latency <ms>    add round trip latency to the connection
+  // --warm <n>        nvim processes kept started for new sessions (default 1)
+  // --connect <host:port>  use an already running nvim --listen (or fake_nvim)
+  std::string capturePath;
+  std::string replayPath;
+  bool replayFast = false;
+  milliseconds latency{0};
+  size_t warmSessions = 1;
+  std::optional<rpc::TcpEndpoint> connectEndpoint;
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+    if (arg == "--capture" && i + 1 < argc) {
+      capturePath = argv[++i];
+    } else if (arg == "--replay" && i + 1 < argc) {
+      replayPath = argv[++i];
+    } else if (arg == "--replay-fast") {
+      replayFast = true;
+    } else if (arg == "--latency" && i + 1 < argc) {
+      latency = milliseconds(std::atoi(argv[++i]));
+    } else if (arg == "--warm" && i + 1 < argc) {
+      warmSessions = std::max(std::atoi(argv[++i]), 0);
+    } else if (arg == "--connect" && i + 1 < argc) {
+      std::string_view address = argv[++i];
+      auto colon = address.rfind(':');
+      if (colon == std::string_view::npos) {
+        LOG_ERR("--connect expects host:port, got {}", address);
+        return 1;
+      }
+      connectEndpoint = rpc::TcpEndpoint{
+        std::string(address.substr(0, colon)),
+        uint16_t(std::atoi(address.substr(colon + 1).data())),
+      };
+    } else {
+      LOG_WARN("Unknown argument: {}", arg);
+    }
+  }
+
   if (SDL_Init(SDL_INIT_VIDEO)) {
     LOG_ERR("Unable to initialize SDL: {}", SDL_GetError());
     return 1;
@@ -46,22 +110,32 @@ int main() {
   }
 
   try {
-    SessionManager sessionManager(SpawnMode::Child);
+    // replays and --connect never spawn nvim for the first session
+    bool spawnsNvim = replayPath.empty() && !connectEndpoint;
+    SessionManager sessionManager(SpawnMode::Child, spawnsNvim ? warmSessions : 0);
     // SessionManager sessionManager(SpawnMode::Detached);
 
-    uint16_t port = 2040;
-    port = sessionManager.GetOrCreateSession("default");
-    Nvim nvim("localhost", port);
+    rpc::Endpoint endpoint;
+    if (!replayPath.empty()) {
+      endpoint = rpc::ReplayEndpoint{replayPath, !replayFast};
+    } else if (connectEndpoint) {
+      endpoint = *connectEndpoint;
+    } else {
+      endpoint = sessionManager.GetOrCreateSession("default");
+    }
+    auto firstNvim = std::make_unique<Nvim>(endpoint, latency / 2);
+    if (!capturePath.empty()) {
+      firstNvim->client.StartCapture(capturePath);
+    }
 
     Options options;
-    options.Load(nvim);
+    options.Load(*firstNvim);
 
     // sdl::Window window({1600, 1000}, "Neovim GUI", options.window);
     sdl::Window window({1200, 800}, "Neovim GUI", options.window);
 
     // create font
-    std::string guifont = nvim.GetOptionValue("guifont", {})->convert();
-    auto fontFamilyResult = FontFamily::FromGuifont(guifont, window.dpiScale);
+    auto fontFamilyResult = FontFamily::FromGuifont(options.guifont, window.dpiScale);
     if (!fontFamilyResult) {
       LOG_ERR("Failed to create font family: {}", fontFamilyResult.error());
       return 1;
@@ -75,25 +149,20 @@ int main() {
 
     Renderer renderer(sizes);
 
-    EditorState editorState{
-      .winManager{.sizes = sizes},
-      .cursor{.fullSize = sizes.charSize},
-    };
-    editorState.winManager.gridManager = &editorState.gridManager;
-    if (options.transparency < 1) {
-      auto& hl = editorState.hlTable[0];
-      hl.background = IntToColor(options.bgColor);
-      hl.background->a = options.transparency;
-    }
-
-    nvim.UiAttach(
-      sizes.uiWidth, sizes.uiHeight,
-      {
-        {"rgb", true},
-        {"ext_multigrid", options.multigrid},
-        {"ext_linegrid", true},
-      }
+    // every session parses in the background, only the current one is drawn
+    // and gets input. the render thread owns the list and only changes it
+    // (or current) while holding sessionsMutex, other threads lock to read
+    std::mutex sessionsMutex;
+    std::vector<std::unique_ptr<Session>> sessions;
+    sessions.push_back(
+      std::make_unique<Session>("default", std::move(firstNvim), options, sizes)
     );
+    Session* current = sessions.front().get();
+
+    auto wakeRenderThread = [&] {
+      std::scoped_lock lock(sessionsMutex);
+      current->nvim->uiEvents.Wakeup();
+    };
 
     // main loop -----------------------------------
     // lock whenever ctx.device is used
@@ -103,15 +172,158 @@ int main() {
     TSQueue<SDL_Event> resizeEvents;
     TSQueue<SDL_Event> sdlEvents;
 
+    // reported after replays and --connect runs (load tests against fake_nvim).
+    // stage busy times are in each session's nvim->redrawTimes
+    size_t numFrames = 0;
+    // frames drawn, redraw arrival to the frame showing it,
+    // and how long decoded flushes waited for the render thread
+    size_t numPresented = 0;
+    rpc::LatencyHistogram applyLatency;
+    rpc::LatencyHistogram handoffLatency;
+    auto runStart = Time();
+
     std::thread renderThread([&] {
       bool windowFocused = true;
       bool idle = false;
       float idleElasped = 0;
+      bool firstFrame = true;
+      std::vector<SessionCmd> sessionCmds;
+
+      // windows that changed in the background are rendered on the next frame,
+      // the rest still have their textures, so switching is a single frame
+      auto switchTo = [&](Session* session) {
+        if (session == current) return;
+        {
+          std::scoped_lock lock(sessionsMutex);
+          current = session;
+        }
+        session->editorState.winManager.dirty = true;
+        session->editorState.cursor.blinkState = BlinkState::Wait;
+        session->editorState.cursor.blinkElasped = 0;
+        idle = false;
+        idleElasped = 0;
+      };
+
+      auto findSession = [&](std::string_view name) -> Session* {
+        for (auto& session : sessions) {
+          if (session->name == name) return session.get();
+        }
+        return nullptr;
+      };
+
+      // spawning and connecting can take a while (connects retry for up to 2s),
+      // so nvim is started off the render thread. the session is made and
+      // attached once it's connected
+      struct PendingSession {
+        std::string name;
+        std::future<std::unique_ptr<Nvim>> nvim;
+      };
+      std::vector<PendingSession> pendingSessions;
+
+      auto isPending = [&](std::string_view name) {
+        return std::ranges::any_of(pendingSessions, [&](auto& pending) {
+          return pending.name == name;
+        });
+      };
+
+      auto addReadySessions = [&] {
+        for (auto it = pendingSessions.begin(); it != pendingSessions.end();) {
+          if (it->nvim.wait_for(0s) != std::future_status::ready) {
+            it++;
+            continue;
+          }
+          auto name = std::move(it->name);
+          auto nvimResult = std::move(it->nvim);
+          it = pendingSessions.erase(it);
+
+          try {
+            auto session =
+              std::make_unique<Session>(name, nvimResult.get(), options, sizes);
+            auto* newSession = session.get();
+            {
+              std::scoped_lock lock(sessionsMutex);
+              sessions.push_back(std::move(session));
+            }
+            switchTo(newSession);
+            LOG_INFO("Created session {}", name);
+          } catch (const std::exception& e) {
+            LOG_ERR("Failed to create session {}: {}", name, e.what());
+            sessionManager.RemoveSession(name);
+          }
+        }
+      };
+
+      // :NeoguiSession new [name] | switch <name> | next | prev
+      auto handleSessionCmd = [&](const SessionCmd& cmd) {
+        if (cmd.empty()) {
+          LOG_WARN("session_cmd: no command given");
+          return;
+        }
+        const auto& action = cmd[0];
+
+        if (action == "new") {
+          std::string name;
+          if (cmd.size() > 1) {
+            name = cmd[1];
+          } else {
+            for (size_t n = sessions.size();
+                 name.empty() || findSession(name) || isPending(name); n++) {
+              name = std::to_string(n);
+            }
+          }
+          if (auto* session = findSession(name)) {
+            switchTo(session);
+            return;
+          }
+          if (isPending(name)) {
+            LOG_INFO("session_cmd: session {} is still starting", name);
+            return;
+          }
+          if (!replayPath.empty()) {
+            LOG_WARN("session_cmd: can't create sessions while replaying");
+            return;
+          }
+
+          pendingSessions.push_back({
+            .name = name,
+            .nvim = std::async(std::launch::async, [&, name] {
+              auto endpoint = sessionManager.GetOrCreateSession(name);
+              auto nvim = std::make_unique<Nvim>(endpoint, latency / 2);
+              wakeRenderThread();
+              return nvim;
+            }),
+          });
+
+        } else if (action == "switch" && cmd.size() > 1) {
+          if (auto* session = findSession(cmd[1])) {
+            switchTo(session);
+          } else {
+            LOG_WARN("session_cmd: no session named {}", cmd[1]);
+          }
+
+        } else if (action == "next" || action == "prev") {
+          auto it = std::ranges::find_if(sessions, [&](auto& session) {
+            return session.get() == current;
+          });
+          size_t index = it - sessions.begin();
+          size_t step = action == "next" ? 1 : sessions.size() - 1;
+          switchTo(sessions[(index + step) % sessions.size()].get());
+
+        } else {
+          LOG_WARN("session_cmd: unknown command {}", action);
+        }
+      };
 
       Clock clock;
       // Timer timer(10);
 
       while (!exitWindow) {
+        if (idle) {
+          // nothing is animating, so sleep until nvim sends something
+          // or the event loop wakes us up
+          current->nvim->uiEvents.Wait(100ms);
+        }
+
         auto dt = clock.Tick(
           options.maxFps == 0 ? std::nullopt : std::optional(options.maxFps)
         );
@@ -124,26 +336,87 @@ int main() {
         // timer.Start();
 
         // nvim events -------------------------------------------
-        if (!nvim.IsConnected()) {
-          exitWindow = true;
-          sessionManager.RemoveSession("default");
-        };
+        // a session ends when its nvim quits, the window closes with the last one
+        for (auto it = sessions.begin(); it != sessions.end();) {
+          auto& session = **it;
+          if (session.nvim->IsConnected()) {
+            it++;
+            continue;
+          }
+          sessionManager.RemoveSession(session.name);
+          if (sessions.size() == 1) {
+            exitWindow = true;
+            // wake up the event loop so it sees exitWindow
+            SDL_Event quitEvent{.type = SDL_EVENT_QUIT};
+            SDL_PushEvent(&quitEvent);
+            break;
+          }
+
+          LOG_INFO("Session {} ended", session.name);
+          std::unique_ptr<Session> ended;
+          {
+            std::scoped_lock lock(sessionsMutex);
+            ended = std::move(*it);
+            it = sessions.erase(it);
+            if (ended.get() == current) {
+              current = sessions.front().get();
+              current->editorState.winManager.dirty = true;
+              idle = false;
+            }
+          }
+          // outside sessionsMutex, its handlers may be waiting on the event loop
+          std::scoped_lock lock(wgpuDeviceMutex);
+          ended.reset();
+        }
 
-        LOG_DISABLE();
-        ParseEvents(nvim.client, nvim.uiEvents);
-        LOG_ENABLE();
+        numFrames++;
+        // redraws are decoded on each session's parse thread,
+        // only flushed batches get here
+        for (auto& session : sessions) {
+          SessionCmd cmd;
+          while (session->nvim->sessionCmds.TryPop(cmd)) {
+            sessionCmds.push_back(std::move(cmd));
+          }
+        }
 
         // process events ---------------------------------------
+        std::optional<steady_clock::time_point> frameReceived;
         {
           std::scoped_lock lock(wgpuDeviceMutex);
           LOG_DISABLE();
-          if (ParseEditorState(nvim.uiEvents, editorState)) {
+          for (auto& session : sessions) {
+            auto& uiEvents = session->nvim->uiEvents;
+            if (uiEvents.NumFlushes() > 0) {
+              // the oldest flush, for the latencies of the frame showing it
+              auto& front = uiEvents.Front();
+              handoffLatency.Record(Time() - front.decoded);
+              if (session.get() == current) frameReceived = front.received;
+            }
+            auto& times = session->nvim->redrawTimes;
+            times.Begin(RedrawStage::Apply);
+            bool processed = ParseEditorState(uiEvents, session->editorState);
+            times.End(RedrawStage::Apply);
+            if (processed && session.get() == current) {
+              idle = false;
+              idleElasped = 0;
+            }
+          }
+          auto& predictor = current->editorState.predictor;
+          if (predictor.Update(current->editorState.gridManager)) {
             idle = false;
             idleElasped = 0;
           }
           LOG_ENABLE();
         }
 
+        for (auto& cmd : sessionCmds) {
+          handleSessionCmd(cmd);
+        }
+        sessionCmds.clear();
+        addReadySessions();
+
+        auto& editorState = current->editorState;
+
         // update ----------------------------------------------
         while (!resizeEvents.Empty()) {
           // only process the last 2 resize events
@@ -167,7 +440,9 @@ int main() {
 
                 sdl::Window::_ctx.Resize(sizes.fbSize);
                 renderer.Resize(sizes);
-                nvim.UiTryResize(sizes.uiWidth, sizes.uiHeight);
+                for (auto& session : sessions) {
+                  session->nvim->UiTryResize(sizes.uiWidth, sizes.uiHeight);
+                }
                 break;
               }
             }
@@ -239,6 +514,8 @@ int main() {
         }
         {
           std::scoped_lock lock(wgpuDeviceMutex);
+          auto& times = current->nvim->redrawTimes;
+          times.Begin(RedrawStage::Draw);
           renderer.Begin();
 
           bool renderWindows = false;
@@ -295,6 +572,15 @@ int main() {
 
           ctx.surface.Present();
           ctx.device.Tick();
+          times.End(RedrawStage::Draw);
+        }
+        numPresented++;
+        if (frameReceived) applyLatency.Record(Time() - *frameReceived);
+
+        if (firstFrame && !editorState.winManager.windows.empty()) {
+          firstFrame = false;
+          auto time = current->nvim->client.metrics.MarkStartup("first frame");
+          LOG_INFO("First frame after {}ms", duration_cast<milliseconds>(time).count());
         }
 
         // timer.End();
@@ -304,9 +590,11 @@ int main() {
     });
 
     // event loop --------------------------------
-    InputHandler input(
-      nvim, editorState.winManager, options.macOptAsAlt, options.multigrid
-    );
+    // input goes to the current session
+    auto withInput = [&](auto&& handle) {
+      std::scoped_lock lock(sessionsMutex);
+      handle(current->input);
+    };
 
     SDL_StartTextInput();
     // SDL_Rect rect{0, 0, 100, 100};
@@ -317,9 +605,11 @@ int main() {
       switch (event.type) {
         case SDL_EVENT_WINDOW_RESIZED:
           resizeEvents.Push(event);
+          wakeRenderThread();
           break;
         case SDL_EVENT_WINDOW_PIXEL_SIZE_CHANGED: {
           resizeEvents.Push(event);
+          wakeRenderThread();
           break;
         }
       }
@@ -336,31 +626,41 @@ int main() {
         case SDL_EVENT_QUIT:
           LOG("exit window");
           exitWindow = true;
+          wakeRenderThread();
           break;
 
         // keyboard handling ----------------------
         case SDL_EVENT_KEY_DOWN:
         case SDL_EVENT_KEY_UP:
-          input.HandleKeyboard(event.key);
+          withInput([&](InputHandler& input) { input.HandleKeyboard(event.key); });
           sdlEvents.Push(event);
           break;
 
         case SDL_EVENT_TEXT_EDITING:
           break;
         case SDL_EVENT_TEXT_INPUT:
-          input.HandleTextInput(event.text);
+          withInput([&](InputHandler& input) { input.HandleTextInput(event.text); });
+          break;
+
+        case SDL_EVENT_DROP_TEXT:
+        case SDL_EVENT_DROP_FILE:
+          withInput([&](InputHandler& input) { input.HandleDrop(event.drop); });
           break;
 
         // mouse handling ------------------------
         case SDL_EVENT_MOUSE_BUTTON_DOWN:
         case SDL_EVENT_MOUSE_BUTTON_UP:
-          input.HandleMouseButton(event.button);
+          withInput([&](InputHandler& input) {
+            input.HandleMouseButton(event.button);
+          });
           break;
         case SDL_EVENT_MOUSE_MOTION:
-          input.HandleMouseMotion(event.motion);
+          withInput([&](InputHandler& input) {
+            input.HandleMouseMotion(event.motion);
+          });
           break;
         case SDL_EVENT_MOUSE_WHEEL:
-          input.HandleMouseWheel(event.wheel);
+          withInput([&](InputHandler& input) { input.HandleMouseWheel(event.wheel); });
           break;
 
         // window handling -----------------------
@@ -371,23 +671,77 @@ int main() {
           if (prevDpiScale == window.dpiScale) break;
           // LOG("display scale changed: {}", window.dpiScale);
           fontFamily.ChangeDpiScale(window.dpiScale);
-          editorState.cursor.fullSize = fontFamily.DefaultFont().charSize;
+          std::scoped_lock sessionsLock(sessionsMutex);
+          for (auto& session : sessions) {
+            session->editorState.cursor.fullSize = fontFamily.DefaultFont().charSize;
+          }
           break;
         }
 
         case SDL_EVENT_WINDOW_FOCUS_GAINED:
         case SDL_EVENT_WINDOW_FOCUS_LOST:
           sdlEvents.Push(event);
+          wakeRenderThread();
+          break;
+
+        default:
+          if (event.type == sdl::MainThreadEvent()) {
+            sdl::RunMainThreadTasks();
+          }
           break;
       }
     }
 
     renderThread.join();
-    if (nvim.IsConnected()) {
-      // send escape so nvim doesn't get stuck when reattaching
-      // prevents cmd + q exiting window getting stuck
-      nvim.Input("<Esc>");
-      nvim.UiDetach();
+    if (!replayPath.empty() || connectEndpoint) {
+      auto& nvim = *sessions.front()->nvim;
+      auto stats = nvim.client.NotificationStats();
+      LOG_INFO(
+        "Run: {} frames, {} notifications (max queued {})", numFrames, stats.popped,
+        stats.maxDepth
+      );
+      auto ms = [](nanoseconds time) {
+        return duration<double, std::milli>(time).count();
+      };
+      auto elapsed = duration<double>(Time() - runStart).count();
+      // busy time per stage, and how much of it ran alongside the other stages
+      auto& times = nvim.redrawTimes;
+      auto busy = [&](RedrawStage stage) {
+        return std::format(
+          "{:.1f}ms ({:.1f}%)", ms(times.Busy(stage)),
+          100 * duration<double>(times.Busy(stage)).count() / elapsed
+        );
+      };
+      LOG_INFO(
+        "Run: decode {}, apply {}, draw {}", busy(RedrawStage::Decode),
+        busy(RedrawStage::Apply), busy(RedrawStage::Draw)
+      );
+      LOG_INFO(
+        "Run: decode overlapped apply {:.1f}ms, draw {:.1f}ms",
+        ms(times.Overlap(RedrawStage::Decode, RedrawStage::Apply)),
+        ms(times.Overlap(RedrawStage::Decode, RedrawStage::Draw))
+      );
+      LOG_INFO("Run: {}", nvim.coalesceStats.Dump());
+      LOG_INFO(
+        "Run: handoff wait mean {:.1f}ms p50 {:.1f}ms p99 {:.1f}ms",
+        ms(handoffLatency.Mean()), ms(handoffLatency.Percentile(0.5)),
+        ms(handoffLatency.Percentile(0.99))
+      );
+      LOG_INFO(
+        "Run: {} frames presented in {:.1f}s ({:.1f} fps), peak rss {:.1f}MB",
+        numPresented, elapsed, numPresented / elapsed, PeakRss() / 1e6
+      );
+      LOG_INFO(
+        "Run: apply latency mean {:.1f}ms p50 {:.1f}ms p99 {:.1f}ms max {:.1f}ms",
+        ms(applyLatency.Mean()), ms(applyLatency.Percentile(0.5)),
+        ms(applyLatency.Percentile(0.99)), ms(applyLatency.max)
+      );
+    }
+    for (auto& session : sessions) {
+      if (session->editorState.predictor.enabled) {
+        LOG_INFO("{}: {}", session->name, session->editorState.predictor.DumpStats());
+      }
+      session->Detach();
       // LOG_INFO("Detached UI");
     }
 
@@ -0,0 +1,104 @@
+#include "ascii_cells.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+#if defined(__AVX2__)
+constexpr size_t vectorBytes = 32;
+#elif defined(__SSE2__) || defined(_M_X64) || \
+  (defined(__ARM_NEON) && defined(__aarch64__))
+constexpr size_t vectorBytes = 16;
+#else
+constexpr size_t vectorBytes = 0;
+#endif
+
+// a block is three vectors, which holds a whole number of 3 byte cells
+constexpr size_t blockCells = vectorBytes;
+constexpr size_t blockBytes = 3 * blockCells;
+
+// a byte of the block matches when (byte & mask) == expect,
+// so the char's top bit has to be clear
+constexpr uint8_t cellExpect[3] = {0x91, 0xa1, 0x00};
+constexpr uint8_t cellMask[3] = {0xff, 0xff, 0x80};
+
+template <const uint8_t (&pattern)[3]>
+constexpr auto blockPattern = [] {
+  std::array<uint8_t, blockBytes> bytes{};
+  for (size_t i = 0; i < bytes.size(); i++) {
+    bytes[i] = pattern[i % 3];
+  }
+  return bytes;
+}();
+
+alignas(32) constexpr auto blockExpect = blockPattern<cellExpect>;
+alignas(32) constexpr auto blockMask = blockPattern<cellMask>;
+
+bool CellMatches(const uint8_t* p) {
+  return p[0] == cellExpect[0] && p[1] == cellExpect[1] && (p[2] & cellMask[2]) == 0;
+}
+
+// all blockCells cells at p match
+bool BlockMatches(const uint8_t* p) {
+#if defined(__AVX2__)
+  __m256i all = _mm256_set1_epi8(-1);
+  for (size_t i = 0; i < blockBytes; i += vectorBytes) {
+    auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+    auto mask = _mm256_load_si256(reinterpret_cast<const __m256i*>(&blockMask[i]));
+    auto expect = _mm256_load_si256(reinterpret_cast<const __m256i*>(&blockExpect[i]));
+    all = _mm256_and_si256(all, _mm256_cmpeq_epi8(_mm256_and_si256(v, mask), expect));
+  }
+  return uint32_t(_mm256_movemask_epi8(all)) == 0xffffffff;
+
+#elif defined(__SSE2__) || defined(_M_X64)
+  __m128i all = _mm_set1_epi8(-1);
+  for (size_t i = 0; i < blockBytes; i += vectorBytes) {
+    auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+    auto mask = _mm_load_si128(reinterpret_cast<const __m128i*>(&blockMask[i]));
+    auto expect = _mm_load_si128(reinterpret_cast<const __m128i*>(&blockExpect[i]));
+    all = _mm_and_si128(all, _mm_cmpeq_epi8(_mm_and_si128(v, mask), expect));
+  }
+  return _mm_movemask_epi8(all) == 0xffff;
+
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  uint8x16_t all = vdupq_n_u8(0xff);
+  for (size_t i = 0; i < blockBytes; i += vectorBytes) {
+    auto v = vld1q_u8(p + i);
+    auto mask = vld1q_u8(&blockMask[i]);
+    auto expect = vld1q_u8(&blockExpect[i]);
+    all = vandq_u8(all, vceqq_u8(vandq_u8(v, mask), expect));
+  }
+  return vminvq_u8(all) == 0xff;
+
+#else
+  (void)p;
+  return false;
+#endif
+}
+
+} // namespace
+
+size_t AsciiCellRun(const char* data, size_t size, size_t maxCells) {
+  const auto* p = reinterpret_cast<const uint8_t*>(data);
+  size_t maxBytes = std::min(size / 3, maxCells) * 3;
+  size_t offset = 0;
+  if constexpr (blockCells > 0) {
+    while (offset + blockBytes <= maxBytes && BlockMatches(p + offset)) {
+      offset += blockBytes;
+    }
+  }
+  while (offset < maxBytes && CellMatches(p + offset)) {
+    offset += 3;
+  }
+  return offset / 3;
+}
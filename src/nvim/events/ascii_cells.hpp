@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstddef>
+
+// Counts the cells at the start of data that are a lone ascii char, most cells
+// of a grid_line: [c] without hl_id or repeat, packed as 91 a1 c.
+// Blocks of cells are checked at once with AVX2, SSE2 or NEON where the build
+// targets them, the rest one at a time. At most maxCells are counted,
+// the char of cell k is data[3 * k + 2].
+size_t AsciiCellRun(const char* data, size_t size, size_t maxCells);
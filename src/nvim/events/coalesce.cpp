@@ -0,0 +1,279 @@
+#include "coalesce.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <format>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// a grid_line, rows of the same grid only overwrite each other within an epoch,
+// which is bumped by the events that move or reset the grid's cells
+struct LineWrite {
+  uint64_t key; // grid, epoch, row
+  uint32_t index; // into batch.events
+  int start;
+  int end;
+};
+
+enum class Action : uint8_t { Keep, Drop, Replace };
+
+// bumped by these, on their grid
+constexpr auto barrierTypes =
+  vIndicesMask<UiEvent, GridScroll, GridClear, GridResize, GridDestroy>();
+
+int Width(const GridLine& line) {
+  int width = 0;
+  for (const auto& cell : line.cells) {
+    width += cell.repeat;
+  }
+  return width;
+}
+
+// cells of line covering columns [from, to), runs are cut at the edges
+std::span<GridLine::Cell> Slice(const GridLine& line, int from, int to, Arena& arena) {
+  auto cells = arena.NewArray<GridLine::Cell>(line.cells.size());
+  size_t numCells = 0;
+  int col = line.colStart;
+  for (const auto& cell : line.cells) {
+    int start = std::max(col, from);
+    int end = std::min(col + cell.repeat, to);
+    if (start < end) {
+      cells[numCells++] = {cell.text, cell.hlId, end - start};
+    }
+    col += cell.repeat;
+    if (col >= to) break;
+  }
+  return cells.first(numCells);
+}
+
+// concatenates next onto prev, which ends where next starts
+void Merge(GridLine& prev, const GridLine& next, Arena& arena) {
+  auto cells = arena.NewArray<GridLine::Cell>(prev.cells.size() + next.cells.size());
+  std::ranges::copy(prev.cells, cells.begin());
+  size_t numCells = prev.cells.size();
+  for (const auto& cell : next.cells) {
+    auto& last = cells[numCells - 1];
+    if (last.hlId == cell.hlId && last.text == cell.text) {
+      last.repeat += cell.repeat;
+    } else {
+      cells[numCells++] = cell;
+    }
+  }
+  prev.cells = cells.first(numCells);
+}
+
+} // namespace
+
+ElidedEvents CoalesceBatch(UiEventBatch& batch) {
+  ElidedEvents elided;
+  auto& events = batch.events;
+
+  // scratch space kept across flushes, the parse thread does one at a time
+  static thread_local std::vector<Action> actions;
+  static thread_local std::vector<LineWrite> writes;
+  static thread_local std::vector<std::pair<int, uint32_t>> gridEpochs;
+  static thread_local std::vector<int> cursorGrids;
+  static thread_local std::vector<std::pair<int, WinViewport*>> viewports;
+  // pieces of partly overwritten lines, by event index then column
+  static thread_local std::vector<std::pair<uint32_t, GridLine*>> pieces;
+  static thread_local std::vector<std::pair<int, int>> covered;
+  static thread_local std::vector<UiEventRef> kept;
+  actions.assign(events.size(), Action::Keep);
+  writes.clear();
+  gridEpochs.clear();
+  cursorGrids.clear();
+  viewports.clear();
+  pieces.clear();
+
+  auto epoch = [&](int grid) -> uint32_t& {
+    for (auto& [g, e] : gridEpochs) {
+      if (g == grid) return e;
+    }
+    return gridEpochs.emplace_back(grid, 0).second;
+  };
+
+  for (uint32_t i = 0; i < events.size(); i++) {
+    auto event = events[i];
+    if (auto* line = event.GetIf<GridLine>()) {
+      int width = Width(*line);
+      if (width == 0) continue;
+      uint64_t key = (uint64_t(uint32_t(line->grid)) << 40) ^
+                     (uint64_t(epoch(line->grid)) << 20) ^ uint32_t(line->row);
+      writes.push_back({key, i, line->colStart, line->colStart + width});
+
+    } else if (vMaskContains(barrierTypes, event.tag)) {
+      Visit(
+        [&](auto& e) {
+          if constexpr (requires { e.grid; }) epoch(e.grid)++;
+        },
+        event
+      );
+    }
+  }
+
+  // the last cursor goto and viewport of each grid survive
+  for (uint32_t i = events.size(); i-- > 0;) {
+    auto event = events[i];
+    if (auto* e = event.GetIf<GridCursorGoto>()) {
+      if (std::ranges::find(cursorGrids, e->grid) != cursorGrids.end()) {
+        actions[i] = Action::Drop;
+        elided.cursorGotos++;
+      } else {
+        cursorGrids.push_back(e->grid);
+      }
+
+    } else if (auto* e = event.GetIf<WinViewport>()) {
+      auto it = std::ranges::find_if(viewports, [&](const auto& viewport) {
+        return viewport.first == e->grid;
+      });
+      if (it != viewports.end()) {
+        it->second->scrollDelta += e->scrollDelta;
+        actions[i] = Action::Drop;
+        elided.viewports++;
+      } else {
+        viewports.emplace_back(e->grid, e);
+      }
+    }
+  }
+
+  // walk each row's writes from the last one back, subtracting the columns
+  // written after them
+  std::ranges::sort(writes, [](const LineWrite& a, const LineWrite& b) {
+    return a.key != b.key ? a.key < b.key : a.index > b.index;
+  });
+  for (size_t first = 0; first < writes.size();) {
+    size_t last = first;
+    while (last < writes.size() && writes[last].key == writes[first].key) last++;
+    covered.clear();
+
+    for (size_t w = first; w < last; w++) {
+      const auto& write = writes[w];
+      auto& line = *static_cast<GridLine*>(events[write.index].event);
+
+      // covered is sorted and disjoint, collect the gaps inside the write
+      size_t numPieces = pieces.size();
+      int col = write.start;
+      for (auto [start, end] : covered) {
+        if (end <= col) continue;
+        if (start >= write.end) break;
+        if (start > col) {
+          pieces.emplace_back(write.index, batch.arena.New<GridLine>(GridLine{
+            line.grid, line.row, col, Slice(line, col, start, batch.arena)
+          }));
+        }
+        col = std::max(col, end);
+      }
+      bool untouched = col == write.start && pieces.size() == numPieces;
+      if (!untouched && col < write.end) {
+        pieces.emplace_back(write.index, batch.arena.New<GridLine>(GridLine{
+          line.grid, line.row, col, Slice(line, col, write.end, batch.arena)
+        }));
+      }
+
+      if (!untouched) {
+        int survived = 0;
+        for (size_t p = numPieces; p < pieces.size(); p++) {
+          survived += Width(*pieces[p].second);
+        }
+        elided.cells += write.end - write.start - survived;
+        if (pieces.size() == numPieces) {
+          actions[write.index] = Action::Drop;
+          elided.gridLines++;
+        } else {
+          actions[write.index] = Action::Replace;
+        }
+      }
+
+      // add the write to covered, merging what it touches
+      auto it = std::ranges::lower_bound(
+        covered, write.start, {}, &std::pair<int, int>::second
+      );
+      int start = write.start;
+      int end = write.end;
+      auto eraseEnd = it;
+      while (eraseEnd != covered.end() && eraseEnd->first <= end) {
+        start = std::min(start, eraseEnd->first);
+        end = std::max(end, eraseEnd->second);
+        eraseEnd++;
+      }
+      it = covered.erase(it, eraseEnd);
+      covered.insert(it, {start, end});
+    }
+    first = last;
+  }
+  std::ranges::sort(pieces, [](const auto& a, const auto& b) {
+    if (a.first != b.first) return a.first < b.first;
+    return a.second->colStart < b.second->colStart;
+  });
+
+  // rebuild, merging lines that continue the one emitted right before
+  kept.clear();
+  auto emitLine = [&](GridLine* line) {
+    if (!kept.empty()) {
+      // empty lines are kept as they are, so there may be nothing to merge into
+      auto* prev = kept.back().GetIf<GridLine>();
+      if (prev && !prev->cells.empty()) {
+        if (prev->grid == line->grid && prev->row == line->row &&
+            prev->colStart + Width(*prev) == line->colStart) {
+          Merge(*prev, *line, batch.arena);
+          elided.merged++;
+          return;
+        }
+      }
+    }
+    kept.push_back({uint32_t(vIndex<UiEvent, GridLine>()), line});
+  };
+
+  auto piece = pieces.begin();
+  for (uint32_t i = 0; i < events.size(); i++) {
+    auto event = events[i];
+    switch (actions[i]) {
+      case Action::Drop: break;
+      case Action::Replace:
+        for (; piece != pieces.end() && piece->first == i; piece++) {
+          emitLine(piece->second);
+        }
+        break;
+      case Action::Keep:
+        if (auto* line = event.GetIf<GridLine>()) {
+          emitLine(line);
+        } else {
+          kept.push_back(event);
+        }
+        break;
+    }
+  }
+  std::swap(events, kept);
+
+  return elided;
+}
+
+void CoalesceStats::Record(size_t numEvents, const ElidedEvents& elided) {
+  flushes.fetch_add(1, std::memory_order_relaxed);
+  events.fetch_add(numEvents, std::memory_order_relaxed);
+  cells.fetch_add(elided.cells, std::memory_order_relaxed);
+  gridLines.fetch_add(elided.gridLines, std::memory_order_relaxed);
+  merged.fetch_add(elided.merged, std::memory_order_relaxed);
+  cursorGotos.fetch_add(elided.cursorGotos, std::memory_order_relaxed);
+  viewports.fetch_add(elided.viewports, std::memory_order_relaxed);
+  if (elided.Events() > maxElided.load(std::memory_order_relaxed)) {
+    maxElided.store(elided.Events(), std::memory_order_relaxed);
+  }
+}
+
+std::string CoalesceStats::Dump() const {
+  size_t numFlushes = flushes;
+  size_t numElided = gridLines + merged + cursorGotos + viewports;
+  double perFlush = numFlushes > 0 ? 1.0 / numFlushes : 0;
+  return std::format(
+    "coalescing elided {} of {} events in {} flushes ({:.1f}%, max {} in one), "
+    "per flush: {:.2f} grid_line ({:.1f} cells) {:.2f} merged {:.2f} cursor_goto "
+    "{:.2f} viewport",
+    numElided, size_t(events), numFlushes,
+    events > 0 ? 100.0 * numElided / events : 0.0, size_t(maxElided),
+    gridLines * perFlush, cells * perFlush, merged * perFlush, cursorGotos * perFlush,
+    viewports * perFlush
+  );
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "ui.hpp"
+#include <atomic>
+#include <cstddef>
+#include <string>
+
+// what CoalesceBatch dropped from one flush
+struct ElidedEvents {
+  size_t cells = 0;       // grid_line cell writes overwritten later in the flush
+  size_t gridLines = 0;   // grid_line events with every cell overwritten
+  size_t merged = 0;      // grid_line events merged into the segment before them
+  size_t cursorGotos = 0; // grid_cursor_goto followed by another on the same grid
+  size_t viewports = 0;   // win_viewport followed by another on the same grid
+
+  size_t Events() const {
+    return gridLines + merged + cursorGotos + viewports;
+  }
+};
+
+// Drops events of a finished flush that later events in it make redundant,
+// so the render thread applies less:
+//   grid_line cells a later grid_line overwrites, partly overwritten lines
+//     are cut down to the cells that survive
+//   all but the last grid_cursor_goto and win_viewport of each grid, scroll
+//     deltas of the dropped viewports are added to the last one
+//   grid_line segments continuing the one right before them are merged
+// grid_scroll, grid_clear, grid_resize and grid_destroy move or reset cells,
+// so lines before them are never treated as overwritten by lines after.
+ElidedEvents CoalesceBatch(UiEventBatch& batch);
+
+// Totals over every coalesced flush of a session.
+// Recorded by the parse thread, dumped from anywhere.
+struct CoalesceStats {
+  std::atomic_size_t flushes = 0;
+  std::atomic_size_t events = 0; // in the flushes before coalescing
+  std::atomic_size_t cells = 0;
+  std::atomic_size_t gridLines = 0;
+  std::atomic_size_t merged = 0;
+  std::atomic_size_t cursorGotos = 0;
+  std::atomic_size_t viewports = 0;
+  std::atomic_size_t maxElided = 0; // most events dropped from a single flush
+
+  void Record(size_t numEvents, const ElidedEvents& elided);
+  // one line, totals and means per flush
+  std::string Dump() const;
+};
@@ -1,19 +1,34 @@
 #include "parse.hpp"
 #include "utils/logger.hpp"
 
-void ParseEvents(rpc::Client& client, UiEvents& uiEvents) {
-  uiEvents.numFlushes = 0;
-
+void ParseEvents(
+  rpc::Client& client,
+  UiEvents& uiEvents,
+  SpscQueue<SessionCmd>& sessionCmds,
+  RedrawTimes& times
+) {
   while (client.HasNotification()) {
     auto notification = client.PopNotification();
 
     if (notification.method == "redraw") {
-      ParseUiEvent(notification.params, uiEvents);
+      auto& batch = uiEvents.Curr();
+      if (!batch.received) batch.received = notification.received;
+      times.Begin(RedrawStage::Decode);
+      ParseUiEvent(notification.raw, uiEvents, &client.metrics);
+      times.End(RedrawStage::Decode);
+      client.Recycle(std::move(notification));
 
     } else if (notification.method == "session_cmd") {
-      LOG_INFO("Session notification: {}", ToString(notification.params));
+      try {
+        if (!sessionCmds.TryPush(notification.params.as<SessionCmd>())) {
+          LOG_WARN("Dropped session_cmd, too many queued");
+        }
+        // render thread may be idle
+        uiEvents.Wakeup();
+      } catch (const msgpack::type_error&) {
+        LOG_WARN("Invalid session_cmd: {}", ToString(notification.params));
+      }
 
     }
   }
 }
-
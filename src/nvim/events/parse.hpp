@@ -1,6 +1,25 @@
 #pragma once
 
 #include "nvim/msgpack_rpc/client.hpp"
+#include "nvim/msgpack_rpc/spsc_queue.hpp"
+#include "utils/stage_times.hpp"
 #include "ui.hpp"
+#include <string>
+#include <vector>
 
-void ParseEvents(rpc::Client& client, UiEvents& uiEvents);
+// arguments of :NeoguiSession, handled by the app
+using SessionCmd = std::vector<std::string>;
+
+// what happens to a redraw after it's read, decoding runs on the parse thread
+// (see Nvim), applying and drawing on the render thread
+enum class RedrawStage { Decode, Apply, Draw, Count };
+using RedrawTimes = StageTimes<RedrawStage>;
+
+// decodes the queued notifications, flushed redraws come out of uiEvents
+// and session_cmd args out of sessionCmds
+void ParseEvents(
+  rpc::Client& client,
+  UiEvents& uiEvents,
+  SpscQueue<SessionCmd>& sessionCmds,
+  RedrawTimes& times
+);
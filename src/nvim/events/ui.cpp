@@ -1,25 +1,36 @@
 #include "ui.hpp"
+#include "ascii_cells.hpp"
+#include "coalesce.hpp"
 #include "utils/logger.hpp"
+#include "nvim/msgpack_rpc/cursor.hpp"
+#include "utils/perfect_hash.hpp"
+#include "utils/worker_pool.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <iterator>
+#include <vector>
 
 // clang-format off
 using UiEventFunc = void (*)(const msgpack::object& args, UiEvents& state);
-static const std::unordered_map<std::string_view, UiEventFunc> uiEventFuncs = {
+static constexpr std::pair<std::string_view, UiEventFunc> uiEventFuncs[] = {
   // Global Events ----------------------------------------------------------
   {"set_title", [](const msgpack::object& args, UiEvents& uiEvents) {
-    uiEvents.Curr().emplace_back(args.as<SetTitle>());
+    uiEvents.Curr().Add(args.as<SetTitle>());
   }},
 
   {"set_icon", [](const msgpack::object& args, UiEvents& uiEvents) {
-    uiEvents.Curr().emplace_back(args.as<SetIcon>());
+    uiEvents.Curr().Add(args.as<SetIcon>());
   }},
 
   {"mode_info_set", [](const msgpack::object& args, UiEvents& uiEvents) {
-    uiEvents.Curr().emplace_back(args.as<ModeInfoSet>());
+    uiEvents.Curr().Add(args.as<ModeInfoSet>());
   }},
 
   {"option_set", [](const msgpack::object& args, UiEvents& uiEvents) {
     // LOG_INFO("option_set: {}", ToString(args));
-    uiEvents.Curr().emplace_back(args.as<OptionSet>());
+    uiEvents.Curr().Add(args.as<OptionSet>());
   }},
 
   {"chdir", [](const msgpack::object& args, UiEvents& uiEvents) {
@@ -27,175 +38,616 @@ static const std::unordered_map<std::string_view, UiEventFunc> uiEventFuncs = {
   }},
 
   {"mode_change", [](const msgpack::object& args, UiEvents& uiEvents) {
-    uiEvents.Curr().emplace_back(args.as<ModeChange>());
+    uiEvents.Curr().Add(args.as<ModeChange>());
   }},
 
   {"mouse_on", [](const msgpack::object&, UiEvents& uiEvents) {
-    uiEvents.Curr().emplace_back(MouseOn{});
+    uiEvents.Curr().Add(MouseOn{});
   }},
 
   {"mouse_off", [](const msgpack::object&, UiEvents& uiEvents) {
-    uiEvents.Curr().emplace_back(MouseOff{});
+    uiEvents.Curr().Add(MouseOff{});
   }},
 
   {"busy_start", [](const msgpack::object&, UiEvents& uiEvents) {
-    uiEvents.Curr().emplace_back(BusyStart{});
+    uiEvents.Curr().Add(BusyStart{});
   }},
 
   {"busy_stop", [](const msgpack::object&, UiEvents& uiEvents) {
-    uiEvents.Curr().emplace_back(BusyStop{});
+    uiEvents.Curr().Add(BusyStop{});
   }},
 
   {"update_menu", [](const msgpack::object&, UiEvents& uiEvents) {
-    uiEvents.Curr().emplace_back(UpdateMenu{});
+    uiEvents.Curr().Add(UpdateMenu{});
   }},
 
   {"flush", [](const msgpack::object&, UiEvents& uiEvents) {
     LOG("flush ---------------------------- ");
-    uiEvents.Curr().emplace_back(Flush{});
-    uiEvents.queue.emplace_back();
-    uiEvents.numFlushes++;
+    auto& batch = uiEvents.Curr();
+    batch.Add(Flush{});
+    if (uiEvents.coalesceStats) {
+      size_t numEvents = batch.events.size();
+      uiEvents.coalesceStats->Record(numEvents, CoalesceBatch(batch));
+    }
+    uiEvents.EndBatch();
   }},
 
   {"default_colors_set", [](const msgpack::object& args, UiEvents& uiEvents) {
     // LOG_INFO("default_colors_set: {}", ToString(args));
-    uiEvents.Curr().emplace_back(args.as<DefaultColorsSet>());
-  }},
-
-  {"hl_attr_define", [](const msgpack::object& args, UiEvents& uiEvents) {
-    // LOG_INFO("hl_attr_define: {}", ToString(args));
-    uiEvents.Curr().emplace_back(args.as<HlAttrDefine>());
+    uiEvents.Curr().Add(args.as<DefaultColorsSet>());
   }},
 
   {"hl_group_set", [](const msgpack::object& args, UiEvents& uiEvents) {
-    uiEvents.Curr().emplace_back(args.as<HlGroupSet>());
+    uiEvents.Curr().Add(args.as<HlGroupSet>());
   }},
 
   // Grid Events --------------------------------------------------------------
   {"grid_resize", [](const msgpack::object& args, UiEvents& uiEvents) {
     LOG("grid_resize: {}", ToString(args));
-    uiEvents.Curr().emplace_back(args.as<GridResize>());
+    uiEvents.Curr().Add(args.as<GridResize>());
   }},
 
   {"grid_clear", [](const msgpack::object& args, UiEvents& uiEvents) {
     LOG("grid_clear: {}", ToString(args));
-    uiEvents.Curr().emplace_back(args.as<GridClear>());
-  }},
-
-  {"grid_cursor_goto", [](const msgpack::object& args, UiEvents& uiEvents) {
-    uiEvents.Curr().emplace_back(args.as<GridCursorGoto>());
-  }},
-
-  {"grid_line", [](const msgpack::object& args, UiEvents& uiEvents) {
-    auto [grid, row, col_start, cells, wrap] =
-      args.as<std::tuple<int, int, int, msgpack::object, bool>>();
-    GridLine gridLine{grid, row, col_start, {}};
-
-    std::span<const msgpack::object> cellsList(cells.via.array);
-    gridLine.cells.reserve(cellsList.size());
-
-    int recent_hl_id;
-    for (const auto& cell : cellsList) {
-      switch (cell.via.array.size) {
-        case 3: {
-          auto [text, hl_id, repeat] = cell.as<std::tuple<std::string, int, int>>();
-          gridLine.cells.emplace_back(std::move(text), hl_id, repeat);
-          recent_hl_id = hl_id;
-          break;
-        }
-        case 2: {
-          auto [text, hl_id] = cell.as<std::tuple<std::string, int>>();
-          gridLine.cells.emplace_back(std::move(text), hl_id);
-          recent_hl_id = hl_id;
-          break;
-        }
-        case 1: {
-          auto [text] = cell.as<std::tuple<std::string>>();
-          gridLine.cells.emplace_back(std::move(text), recent_hl_id);
-          break;
-        }
-      }
-    }
-
-    uiEvents.Curr().emplace_back(std::move(gridLine));
+    uiEvents.Curr().Add(args.as<GridClear>());
   }},
 
   {"grid_scroll", [](const msgpack::object& args, UiEvents& uiEvents) {
-    uiEvents.Curr().emplace_back(args.as<GridScroll>());
+    uiEvents.Curr().Add(args.as<GridScroll>());
   }},
 
   {"grid_destroy", [](const msgpack::object& args, UiEvents& uiEvents) {
     LOG("grid_destroy: {}", ToString(args));
-    uiEvents.Curr().emplace_back(args.as<GridDestroy>());
+    uiEvents.Curr().Add(args.as<GridDestroy>());
   }},
 
   // Multigrid Events ------------------------------------------------------------
   {"win_pos", [](const msgpack::object& args, UiEvents& uiEvents) {
     LOG("win_pos: {}", ToString(args));
-    uiEvents.Curr().emplace_back(args.as<WinPos>());
+    uiEvents.Curr().Add(args.as<WinPos>());
   }},
 
   {"win_float_pos", [](const msgpack::object& args, UiEvents& uiEvents) {
     LOG("win_float_pos: {}", ToString(args));
-    uiEvents.Curr().emplace_back(args.as<WinFloatPos>());
+    uiEvents.Curr().Add(args.as<WinFloatPos>());
   }},
 
   {"win_external_pos", [](const msgpack::object& args, UiEvents& uiEvents) {
     // LOG("win_external_pos: {}", ToString(args));
-    uiEvents.Curr().emplace_back(args.as<WinExternalPos>());
+    uiEvents.Curr().Add(args.as<WinExternalPos>());
   }},
 
   {"win_hide", [](const msgpack::object& args, UiEvents& uiEvents) {
     LOG("win_hide: {}", ToString(args));
-    uiEvents.Curr().emplace_back(args.as<WinHide>());
+    uiEvents.Curr().Add(args.as<WinHide>());
   }},
 
   {"win_close", [](const msgpack::object& args, UiEvents& uiEvents) {
     LOG("win_close: {}", ToString(args));
-    uiEvents.Curr().emplace_back(args.as<WinClose>());
+    uiEvents.Curr().Add(args.as<WinClose>());
   }},
 
   {"msg_set_pos", [](const msgpack::object& args, UiEvents& uiEvents) {
     LOG("msg_set_pos: {}", ToString(args));
-    uiEvents.Curr().emplace_back(args.as<MsgSetPos>());
-  }},
-
-  {"win_viewport", [](const msgpack::object& args, UiEvents& uiEvents) {
-    // LOG("win_viewport: {}", ToString(args));
-    // LOG_INFO("win_viewport: {}", ToString(args));
-    uiEvents.Curr().emplace_back(args.as<WinViewport>());
+    uiEvents.Curr().Add(args.as<MsgSetPos>());
   }},
 
   {"win_viewport_margins", [](const msgpack::object& args, UiEvents& uiEvents) {
     LOG("win_viewport_margins: {}", ToString(args));
     // LOG_INFO("win_viewport_margins: {}", ToString(args));
-    uiEvents.Curr().emplace_back(args.as<WinViewportMargins>());
+    uiEvents.Curr().Add(args.as<WinViewportMargins>());
   }},
 
   {"win_extmark", [](const msgpack::object& args, UiEvents& uiEvents) {
     // LOG("win_extmark: {}", ToString(args));
-    uiEvents.Curr().emplace_back(args.as<WinExtmark>());
+    uiEvents.Curr().Add(args.as<WinExtmark>());
   }},
 };
 // clang-format on
 
-void ParseUiEvent(const msgpack::object& params, UiEvents& uiEvents) {
-  std::span<const msgpack::object> paramList(params.via.array);
+// Hot events are decoded straight from the encoded bytes with msgpack visitors,
+// the rest are unpacked into a scratch zone and converted with the table above.
+// Visitors see the args array of a single event call.
+
+// tracks the item index of each nested array
+struct ArgsVisitor : msgpack::null_visitor {
+  static constexpr int maxDepth = 3;
+  int depth = 0;
+  uint32_t index[maxDepth]{}; // index[d] is the current item in the array at depth d + 1
+
+  bool start_array(uint32_t) {
+    if (depth < maxDepth) index[depth] = 0;
+    depth++;
+    return true;
+  }
+  bool end_array_item() {
+    if (depth <= maxDepth) index[depth - 1]++;
+    return true;
+  }
+  bool end_array() {
+    depth--;
+    return true;
+  }
+};
+
+// single ascii characters point here instead of being copied to the arena
+static constexpr auto asciiChars = [] {
+  std::array<char, 128> chars{};
+  for (size_t i = 0; i < chars.size(); i++) {
+    chars[i] = char(i);
+  }
+  return chars;
+}();
+
+static std::string_view CellText(std::string_view text, Arena& arena) {
+  if (text.size() == 1 && uint8_t(text[0]) < asciiChars.size()) {
+    return {&asciiChars[uint8_t(text[0])], 1};
+  }
+  return arena.Copy(text);
+}
 
-  for (const auto& param : paramList) {
-    const auto& paramArr = param.via.array;
-    std::string_view eventName(paramArr.ptr[0].convert());
-    std::span<const msgpack::object> eventArgs(&paramArr.ptr[1], paramArr.size - 1);
+// [grid, row, col_start, [[text, hl_id?, repeat?], ...], wrap]
+// a cell is at least a fixarray and a fixstr header, so a payload of
+// n bytes holds at most n / 2 cells. array headers are read from the wire,
+// counts past that are clamped so a bad stream can't size the arena
+static constexpr size_t minCellBytes = 2;
+
+// cells go into the arena, the array is sized from the header
+struct GridLineVisitor : ArgsVisitor {
+  GridLine& gridLine;
+  Arena& arena;
+  size_t maxCells;
+  std::span<GridLine::Cell> cells;
+  size_t numCells = 0;
+  GridLine::Cell cell;
+  int recentHlId = 0; // cells without hl_id reuse the last one
+
+  GridLineVisitor(GridLine& _gridLine, Arena& _arena, size_t _maxCells)
+      : gridLine(_gridLine), arena(_arena), maxCells(_maxCells) {
+  }
 
-    auto it = uiEventFuncs.find(eventName);
-    if (it == uiEventFuncs.end()) {
+  bool start_array(uint32_t size) {
+    ArgsVisitor::start_array(size);
+    if (depth == 2) {
+      cells = arena.NewArray<GridLine::Cell>(std::min<size_t>(size, maxCells));
+      numCells = 0;
+    } else if (depth == 3) {
+      cell.text = {};
+      cell.hlId = recentHlId;
+      cell.repeat = 1;
+    }
+    return true;
+  }
+  bool end_array() {
+    if (depth == 3 && numCells < cells.size()) cells[numCells++] = cell;
+    if (depth == 2) gridLine.cells = cells.first(numCells);
+    return ArgsVisitor::end_array();
+  }
+
+  bool visit_str(const char* v, uint32_t size) {
+    if (depth == 3 && index[2] == 0) cell.text = CellText({v, size}, arena);
+    return true;
+  }
+  bool visit_positive_integer(uint64_t v) {
+    SetInt(static_cast<int>(v));
+    return true;
+  }
+  bool visit_negative_integer(int64_t v) {
+    SetInt(static_cast<int>(v));
+    return true;
+  }
+
+  void SetInt(int v) {
+    if (depth == 1) {
+      switch (index[0]) {
+        case 0: gridLine.grid = v; break;
+        case 1: gridLine.row = v; break;
+        case 2: gridLine.colStart = v; break;
+      }
+    } else if (depth == 3) {
+      switch (index[2]) {
+        case 1: cell.hlId = recentHlId = v; break;
+        case 2: cell.repeat = v; break;
+      }
+    }
+  }
+};
+
+// flat args of ints, the int at index i goes to fields[i] (nullptr skips),
+// an ext (window handle) goes to ext
+template <size_t N>
+struct IntArgsVisitor : ArgsVisitor {
+  std::array<int*, N> fields;
+  msgpack::type::ext* ext;
+
+  IntArgsVisitor(std::array<int*, N> _fields, msgpack::type::ext* _ext = nullptr)
+      : fields(_fields), ext(_ext) {
+  }
+
+  bool visit_positive_integer(uint64_t v) {
+    SetInt(static_cast<int>(v));
+    return true;
+  }
+  bool visit_negative_integer(int64_t v) {
+    SetInt(static_cast<int>(v));
+    return true;
+  }
+  bool visit_ext(const char* v, uint32_t size) {
+    if (depth == 1 && ext) *ext = msgpack::type::ext(msgpack::type::ext_ref(v, size));
+    return true;
+  }
+
+  void SetInt(int v) {
+    if (depth == 1 && index[0] < N && fields[index[0]]) *fields[index[0]] = v;
+  }
+};
+
+// grid_line args read straight off the cursor, without a visitor call per item.
+// runs of lone ascii chars (no hl_id, so they reuse the last one) are found
+// by AsciiCellRun and filled in without reading each cell.
+// returns false without advancing on anything unexpected, like ints packed
+// as signed, which is left to the visitor
+static bool ReadGridLine(
+  rpc::MsgpackCursor& cursor, GridLine& gridLine, Arena& arena
+) {
+  size_t start = cursor.off;
+  auto fail = [&] {
+    cursor.off = start;
+    return false;
+  };
+
+  uint32_t numArgs;
+  uint64_t grid, row, colStart;
+  uint32_t numCells;
+  if (!cursor.ReadArrayHeader(numArgs) || numArgs < 4 || !cursor.ReadUint(grid) ||
+      !cursor.ReadUint(row) || !cursor.ReadUint(colStart) ||
+      !cursor.ReadArrayHeader(numCells)) {
+    return fail();
+  }
+  // can't be a valid line, the visitor reports it
+  if (numCells > cursor.Remaining() / minCellBytes) return fail();
+
+  auto cells = arena.NewArray<GridLine::Cell>(numCells);
+  int hlId = 0;
+  for (uint32_t i = 0; i < numCells;) {
+    size_t run =
+      AsciiCellRun(cursor.data + cursor.off, cursor.Remaining(), numCells - i);
+    if (run > 0) {
+      const char* chars = cursor.data + cursor.off + 2;
+      for (size_t k = 0; k < run; k++) {
+        cells[i + k] = {{&asciiChars[uint8_t(chars[3 * k])], 1}, hlId, 1};
+      }
+      cursor.off += 3 * run;
+      i += run;
+      continue;
+    }
+
+    uint32_t cellSize;
+    std::string_view text;
+    uint64_t value;
+    if (!cursor.ReadArrayHeader(cellSize) || cellSize == 0 || cellSize > 3 ||
+        !cursor.ReadStr(text)) {
+      return fail();
+    }
+    auto& cell = cells[i++];
+    cell.text = CellText(text, arena);
+    if (cellSize >= 2) {
+      if (!cursor.ReadUint(value)) return fail();
+      hlId = static_cast<int>(value);
+    }
+    cell.hlId = hlId;
+    cell.repeat = 1;
+    if (cellSize == 3) {
+      if (!cursor.ReadUint(value)) return fail();
+      cell.repeat = static_cast<int>(value);
+    }
+  }
+
+  // wrap, and anything added later
+  for (uint32_t j = 4; j < numArgs; j++) {
+    if (!cursor.Skip()) return fail();
+  }
+
+  gridLine.grid = static_cast<int>(grid);
+  gridLine.row = static_cast<int>(row);
+  gridLine.colStart = static_cast<int>(colStart);
+  gridLine.cells = cells;
+  return true;
+}
+
+static bool DecodeGridLine(
+  rpc::MsgpackCursor& cursor, GridLine& gridLine, Arena& arena
+) {
+  if (ReadGridLine(cursor, gridLine, arena)) return true;
+  GridLineVisitor visitor(gridLine, arena, cursor.Remaining() / minCellBytes);
+  return cursor.Parse(visitor);
+}
+
+static bool ParseGridLine(rpc::MsgpackCursor& cursor, UiEvents& uiEvents) {
+  auto& batch = uiEvents.Curr();
+  GridLine gridLine{};
+  if (!DecodeGridLine(cursor, gridLine, batch.arena)) return false;
+  batch.Add(gridLine);
+  return true;
+}
+
+// All lines of a grid_line event, which a full redraw of a big window sends
+// as one event with every row. Lines are found with a skip over the headers,
+// then split into parts of about equal bytes decoded on uiEvents.decodePool,
+// each part into its own arena. Lines are added in their original order,
+// so the batch is the same as decoding them one by one.
+static bool ParseGridLines(
+  rpc::MsgpackCursor& cursor, uint32_t numLines, UiEvents& uiEvents
+) {
+  auto& batch = uiEvents.Curr();
+  // scratch space, referenced through locals since workers have their own
+  static thread_local std::vector<size_t> lineStarts;
+  static thread_local std::vector<uint32_t> partLines;
+  static thread_local std::vector<GridLine*> lineRefs;
+  auto& starts = lineStarts; // numLines + 1, last is where the event ends
+  auto& firstLines = partLines; // numParts + 1, last is numLines
+  auto& lines = lineRefs;
+
+  size_t begin = cursor.off;
+  starts.clear();
+  for (uint32_t j = 0; j < numLines; j++) {
+    starts.push_back(cursor.off);
+    if (!cursor.Skip()) return false;
+  }
+  starts.push_back(cursor.off);
+
+  size_t numBytes = cursor.off - begin;
+  size_t numParts = std::min(
+    uiEvents.decodePool->NumThreads() + 1, numBytes / UiEvents::minPartBytes
+  );
+  if (numParts < 2) {
+    cursor.off = begin;
+    for (uint32_t j = 0; j < numLines; j++) {
+      if (!ParseGridLine(cursor, uiEvents)) return false;
+    }
+    return true;
+  }
+
+  // a part starts at the first line past its share of the bytes
+  firstLines.assign(1, 0);
+  for (size_t part = 1; part < numParts; part++) {
+    size_t partStart = begin + numBytes * part / numParts;
+    auto it = std::lower_bound(starts.begin(), starts.end() - 1, partStart);
+    firstLines.push_back(it - starts.begin());
+  }
+  firstLines.push_back(numLines);
+
+  if (batch.partArenas.size() < numParts) batch.partArenas.resize(numParts);
+  lines.resize(numLines);
+  std::atomic_bool failed = false;
+  uiEvents.decodePool->Run(numParts, [&](size_t part) {
+    auto& arena = batch.partArenas[part];
+    rpc::MsgpackCursor partCursor(cursor.data, starts[firstLines[part + 1]]);
+    partCursor.off = starts[firstLines[part]];
+    for (uint32_t j = firstLines[part]; j < firstLines[part + 1]; j++) {
+      lines[j] = arena.New<GridLine>();
+      if (!DecodeGridLine(partCursor, *lines[j], arena)) {
+        failed = true;
+        return;
+      }
+    }
+  });
+  if (failed) return false;
+
+  for (auto* line : lines) {
+    batch.events.push_back({uint32_t(vIndex<UiEvent, GridLine>()), line});
+  }
+  return true;
+}
+
+static bool ParseGridCursorGoto(rpc::MsgpackCursor& cursor, UiEvents& uiEvents) {
+  GridCursorGoto e{};
+  IntArgsVisitor<3> visitor({&e.grid, &e.row, &e.col});
+  if (!cursor.Parse(visitor)) return false;
+  uiEvents.Curr().Add(e);
+  return true;
+}
+
+// rgb_attr keys, the bit each one sets. ones mapped to 0 are known but unused
+static constexpr std::pair<std::string_view, uint16_t> hlAttrKeys[] = {
+  {"foreground", HlAttrDefine::Foreground},
+  {"background", HlAttrDefine::Background},
+  {"special", HlAttrDefine::Special},
+  {"reverse", HlAttrDefine::Reverse},
+  {"italic", HlAttrDefine::Italic},
+  {"bold", HlAttrDefine::Bold},
+  {"strikethrough", HlAttrDefine::Strikethrough},
+  {"underline", HlAttrDefine::Underline},
+  {"undercurl", HlAttrDefine::Undercurl},
+  {"underdouble", HlAttrDefine::Underdouble},
+  {"underdotted", HlAttrDefine::Underdotted},
+  {"underdashed", HlAttrDefine::Underdashed},
+  {"blend", HlAttrDefine::Blend},
+  {"standout", 0},
+  {"altfont", 0},
+  {"nocombine", 0},
+  {"url", 0},
+};
+static constexpr auto hlAttrNames = [] {
+  std::array<std::string_view, std::size(hlAttrKeys)> names;
+  for (size_t i = 0; i < names.size(); i++) {
+    names[i] = hlAttrKeys[i].first;
+  }
+  return PerfectHash(names);
+}();
+// [id, rgb_attr, cterm_attr, info], only id and rgb_attr are read
+struct HlAttrVisitor : ArgsVisitor {
+  HlAttrDefine& hl;
+  int mapDepth = 0;
+  bool inKey = false;
+  uint16_t attr = 0; // of the value being visited
+
+  HlAttrVisitor(HlAttrDefine& _hl) : hl(_hl) {
+  }
+
+  bool InRgbAttrs() const {
+    return depth == 1 && mapDepth == 1 && index[0] == 1;
+  }
+
+  bool start_map(uint32_t) {
+    mapDepth++;
+    return true;
+  }
+  bool end_map() {
+    mapDepth--;
+    return true;
+  }
+  bool start_map_key() {
+    inKey = true;
+    return true;
+  }
+  bool end_map_key() {
+    inKey = false;
+    return true;
+  }
+
+  bool visit_str(const char* v, uint32_t size) {
+    if (!inKey || !InRgbAttrs()) return true;
+    std::string_view key(v, size);
+    int i = hlAttrNames.Find(key);
+    if (i < 0) {
+      LOG_WARN("unknown hl attr key: {}", key);
+      attr = 0;
+    } else {
+      attr = hlAttrKeys[i].second;
+    }
+    return true;
+  }
+  bool visit_boolean(bool v) {
+    if (InRgbAttrs()) {
+      hl.attrs = v ? hl.attrs | attr : hl.attrs & ~attr;
+    }
+    return true;
+  }
+  bool visit_positive_integer(uint64_t v) {
+    if (depth == 1 && mapDepth == 0 && index[0] == 0) {
+      hl.id = static_cast<int>(v);
+    } else if (InRgbAttrs() && !inKey) {
+      switch (attr) {
+        case HlAttrDefine::Foreground: hl.foreground = v; break;
+        case HlAttrDefine::Background: hl.background = v; break;
+        case HlAttrDefine::Special: hl.special = v; break;
+        case HlAttrDefine::Blend: hl.blend = std::min<uint64_t>(v, 100); break;
+        default: return true;
+      }
+      hl.attrs |= attr;
+    }
+    return true;
+  }
+};
+
+static bool ParseHlAttrDefine(rpc::MsgpackCursor& cursor, UiEvents& uiEvents) {
+  HlAttrDefine e{};
+  HlAttrVisitor visitor(e);
+  if (!cursor.Parse(visitor)) return false;
+  uiEvents.Curr().Add(e);
+  return true;
+}
+
+// the window handle isn't used, skipping it keeps this allocation free
+static bool ParseWinViewport(rpc::MsgpackCursor& cursor, UiEvents& uiEvents) {
+  WinViewport e{};
+  IntArgsVisitor<8> visitor(
+    {&e.grid, nullptr, &e.topline, &e.botline, &e.curline, &e.curcol, &e.lineCount,
+     &e.scrollDelta}
+  );
+  if (!cursor.Parse(visitor)) return false;
+  uiEvents.Curr().Add(std::move(e));
+  return true;
+}
+
+using HotEventFunc = bool (*)(rpc::MsgpackCursor& cursor, UiEvents& uiEvents);
+static constexpr std::pair<std::string_view, HotEventFunc> hotEventFuncs[] = {
+  {"grid_line", ParseGridLine},
+  {"grid_cursor_goto", ParseGridCursorGoto},
+  {"win_viewport", ParseWinViewport},
+  // no object tree or maps, colorscheme changes send hundreds of these
+  {"hl_attr_define", ParseHlAttrDefine},
+};
+
+// every event name, hot events first. index i past the hot events
+// is uiEventFuncs[i - numHotEvents]
+static constexpr size_t numHotEvents = std::size(hotEventFuncs);
+static constexpr auto eventNames = [] {
+  std::array<std::string_view, numHotEvents + std::size(uiEventFuncs)> names;
+  for (size_t i = 0; i < numHotEvents; i++) {
+    names[i] = hotEventFuncs[i].first;
+  }
+  for (size_t i = 0; i < std::size(uiEventFuncs); i++) {
+    names[numHotEvents + i] = uiEventFuncs[i].first;
+  }
+  return PerfectHash(names);
+}();
+static constexpr int gridLineIndex = eventNames.Find("grid_line");
+
+std::span<const std::string_view> UiEventNames() {
+  return eventNames.keys;
+}
+
+void ParseUiEvent(
+  std::span<const char> params, UiEvents& uiEvents, rpc::Metrics* metrics
+) {
+  rpc::MsgpackCursor cursor(params.data(), params.size());
+
+  uint32_t numEvents;
+  if (!cursor.ReadArrayHeader(numEvents)) {
+    LOG_ERR("ParseUiEvent: params is not an array");
+    return;
+  }
+
+  // scratch space for cold events, args are copied out by the converters.
+  // clear() keeps the first chunk around, so it's only allocated once
+  static thread_local msgpack::zone zone;
+
+  for (uint32_t i = 0; i < numEvents; i++) {
+    uint32_t numArgs;
+    std::string_view eventName;
+    if (!cursor.ReadArrayHeader(numArgs) || numArgs == 0 ||
+        !cursor.ReadStr(eventName)) {
+      LOG_ERR("ParseUiEvent: Malformed event");
+      return;
+    }
+    numArgs--;
+
+    int eventIndex = eventNames.Find(eventName);
+    if (metrics) metrics->RecordUiEvent(eventIndex, eventName, numArgs);
+    // small events aren't worth the skip over their lines
+    if (eventIndex == gridLineIndex && numArgs > 1 && uiEvents.decodePool &&
+        cursor.Remaining() >= 2 * UiEvents::minPartBytes) {
+      if (!ParseGridLines(cursor, numArgs, uiEvents)) {
+        LOG_ERR("ParseUiEvent: Failed to decode {}", eventName);
+        return;
+      }
+      continue;
+    }
+    if (eventIndex >= 0 && size_t(eventIndex) < numHotEvents) {
+      auto hotEventFunc = hotEventFuncs[eventIndex].second;
+      for (uint32_t j = 0; j < numArgs; j++) {
+        if (!hotEventFunc(cursor, uiEvents)) {
+          LOG_ERR("ParseUiEvent: Failed to decode {}", eventName);
+          return;
+        }
+      }
+      continue;
+    }
+
+    if (eventIndex < 0) {
       LOG_WARN("Unknown event: {}", eventName);
+      for (uint32_t j = 0; j < numArgs; j++) {
+        cursor.Skip();
+      }
       continue;
     }
-    auto uiEventFunc = it->second;
+    auto uiEventFunc = uiEventFuncs[eventIndex - numHotEvents].second;
 
-    for (const auto& arg : eventArgs) {
-      uiEventFunc(arg, uiEvents);
+    for (uint32_t j = 0; j < numArgs; j++) {
+      uiEventFunc(cursor.Unpack(zone), uiEvents);
     }
+    zone.clear();
   }
 }
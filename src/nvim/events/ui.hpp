@@ -1,6 +1,18 @@
+#pragma once
+
 #include "msgpack.hpp"
 #include "utils/variant.hpp"
+#include "nvim/msgpack_rpc/metrics.hpp"
+#include "nvim/msgpack_rpc/spsc_queue.hpp"
+#include "utils/arena.hpp"
+#include <chrono>
+#include <cstdint>
 #include <map>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <utility>
 
 struct SetTitle {
   std::string title;
@@ -44,13 +56,35 @@ struct DefaultColorsSet {
   int ctermBg;
   MSGPACK_DEFINE(rgbFg, rgbBg, rgbSp, ctermFg, ctermBg);
 };
+// rgb_attr of an hl_attr_define, decoded straight into the record.
+// cterm_attr and info (ext_hlstate only) are skipped
 struct HlAttrDefine {
+  // bits of attrs, the color bits say the color was given
+  enum Attr : uint16_t {
+    Foreground = 1 << 0,
+    Background = 1 << 1,
+    Special = 1 << 2,
+    Reverse = 1 << 3,
+    Italic = 1 << 4,
+    Bold = 1 << 5,
+    Strikethrough = 1 << 6,
+    Underline = 1 << 7,
+    Undercurl = 1 << 8,
+    Underdouble = 1 << 9,
+    Underdotted = 1 << 10,
+    Underdashed = 1 << 11,
+    Blend = 1 << 12,
+  };
   int id;
-  using HlAttrMap = std::map<std::string, msgpack::type::variant>;
-  HlAttrMap rgbAttrs;
-  HlAttrMap ctermAttrs;
-  std::vector<HlAttrMap> info;
-  MSGPACK_DEFINE(id, rgbAttrs, ctermAttrs, info);
+  uint16_t attrs = 0;
+  uint8_t blend = 0; // 0 - 100
+  uint32_t foreground = 0; // 0xRRGGBB
+  uint32_t background = 0;
+  uint32_t special = 0;
+
+  bool Has(Attr attr) const {
+    return attrs & attr;
+  }
 };
 struct HlGroupSet {
   std::string name;
@@ -73,16 +107,17 @@ struct GridCursorGoto {
   int col;
   MSGPACK_DEFINE(grid, row, col);
 };
+// cells and their text live in the batch's arena
 struct GridLine {
   struct Cell {
-    std::string text;
+    std::string_view text;
     int hlId;
     int repeat = 1;
   };
   int grid;
   int row;
   int colStart;
-  std::vector<Cell> cells;
+  std::span<Cell> cells;
 };
 struct GridScroll {
   int grid;
@@ -170,6 +205,7 @@ struct WinExtmark {
   MSGPACK_DEFINE(grid, win, nsId, markId, row, col);
 };
 
+// list of event types, a UiEventRef's tag is the index into it
 using UiEvent = std::variant<
   SetTitle,
   SetIcon,
@@ -202,17 +238,145 @@ using UiEvent = std::variant<
   WinViewportMargins,
   WinExtmark>;
 
+// an event in a UiEventBatch, tag is the UiEvent index of its type
+struct UiEventRef {
+  uint32_t tag;
+  void* event;
+
+  template <typename T>
+  T* GetIf() const {
+    return tag == vIndex<UiEvent, T>() ? static_cast<T*>(event) : nullptr;
+  }
+};
+
+// calls visitor with the event as its actual type (like std::visit)
+template <typename Visitor>
+void Visit(Visitor&& visitor, UiEventRef ref) {
+  [&]<size_t... I>(std::index_sequence<I...>) {
+    using Fn = void (*)(Visitor&, void*);
+    static constexpr Fn table[] = {[](Visitor& v, void* event) {
+      v(*static_cast<std::variant_alternative_t<I, UiEvent>*>(event));
+    }...};
+    table[ref.tag](visitor, ref.event);
+  }(std::make_index_sequence<std::variant_size_v<UiEvent>>());
+}
+
+// Events of a single flush, in order. Payloads are allocated in the arena
+// at their own size, so releasing the batch is an arena reset.
+struct UiEventBatch {
+  Arena arena;
+  // one per part of a grid_line event decoded on the worker pool
+  std::vector<Arena> partArenas;
+  std::vector<UiEventRef> events;
+  // arrival of the first redraw in the batch, and when its flush was decoded
+  std::optional<std::chrono::steady_clock::time_point> received;
+  std::chrono::steady_clock::time_point decoded;
+
+  template <typename T>
+  T& Add(T&& event) {
+    using Event = std::remove_cvref_t<T>;
+    auto* e = arena.New<Event>(std::forward<T>(event));
+    events.push_back({vIndex<UiEvent, Event>(), e});
+    return *e;
+  }
+
+  void Clear() {
+    events.clear();
+    arena.Reset();
+    for (auto& partArena : partArenas) {
+      partArena.Reset();
+    }
+    received.reset();
+  }
+};
+
+struct CoalesceStats;
+struct WorkerPool;
+
+// Hands flushed batches from the thread decoding redraws (Curr, EndBatch)
+// to the thread applying them (NumFlushes, Front, PopFront), without locks.
+// Applied batches flow back to be refilled, so once the arenas and vectors
+// have grown to fit the usual flush, neither side allocates.
 struct UiEvents {
-  int numFlushes = 0;
-  std::deque<std::vector<UiEvent>> queue;
+  // flushes decoded ahead of the consumer before EndBatch blocks
+  static constexpr size_t maxFlushes = 1024;
+  static constexpr size_t maxFreeBatches = 16;
 
-  UiEvents() {
-    queue.emplace_back();
+  // when set, flushes go through CoalesceBatch before they're handed over
+  // and what it drops is recorded here (see coalesce.hpp)
+  CoalesceStats* coalesceStats = nullptr;
+
+  // when set, grid_line events big enough for two parts are split into parts of
+  // at least this many bytes and decoded on the pool, in order within the batch
+  WorkerPool* decodePool = nullptr;
+  static constexpr size_t minPartBytes = 32 << 10;
+
+  UiEvents() = default;
+  UiEvents(const UiEvents&) = delete;
+  UiEvents& operator=(const UiEvents&) = delete;
+
+  // producer --------------------------------------------
+  // batch being filled
+  UiEventBatch& Curr() {
+    return *curr;
+  }
+
+  // after a flush event, hands the batch over and starts a new one.
+  // blocks while maxFlushes are waiting, the batch is dropped after Close()
+  void EndBatch() {
+    curr->decoded = std::chrono::steady_clock::now();
+    if (!flushed.Push(std::move(curr))) {
+      curr->Clear();
+      return;
+    }
+    if (!freeBatches.TryPop(curr)) {
+      curr = std::make_unique<UiEventBatch>();
+    }
+  }
+
+  // unblocks and stops EndBatch, for shutting down the producer
+  void Close() {
+    flushed.Close();
+  }
+
+  // consumer --------------------------------------------
+  // flushed batches ready to be applied
+  size_t NumFlushes() const {
+    return flushed.Size();
+  }
+
+  UiEventBatch& Front() {
+    return **flushed.Front();
+  }
+
+  // releases the front batch once it's applied
+  void PopFront() {
+    auto batch = std::move(*flushed.Front());
+    flushed.Pop();
+    batch->Clear();
+    // pool is small so one burst doesn't pin its batches, the rest are freed
+    freeBatches.TryPush(std::move(batch));
   }
 
-  auto& Curr() {
-    return queue.back();
+  // blocks until a flush is ready, Wakeup() is called or timeout elapses
+  bool Wait(std::chrono::nanoseconds timeout) {
+    return flushed.Wait(timeout);
+  }
+  void Wakeup() {
+    flushed.Wakeup();
   }
+
+private:
+  std::unique_ptr<UiEventBatch> curr = std::make_unique<UiEventBatch>();
+  SpscQueue<std::unique_ptr<UiEventBatch>> flushed{maxFlushes};
+  SpscQueue<std::unique_ptr<UiEventBatch>> freeBatches{maxFreeBatches};
 };
 
-void ParseUiEvent(const msgpack::object& params, UiEvents& uiEvents);
+// every event name ParseUiEvent knows, indexed like the counts it records
+std::span<const std::string_view> UiEventNames();
+
+// params is the encoded params array of a redraw notification,
+// event counts are recorded in metrics if given
+void ParseUiEvent(
+  std::span<const char> params, UiEvents& uiEvents, rpc::Metrics* metrics = nullptr
+);
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "msgpack.hpp"
+#include "asio/any_io_executor.hpp"
+#include "utils/logger.hpp"
+
+#include <coroutine>
+#include <cstdint>
+#include <expected>
+#include <functional>
+#include <optional>
+#include <string>
+
+namespace rpc {
+
+struct Client; // forward decl
+
+// response result, or the error message nvim sent back
+using Result = std::expected<msgpack::object_handle, std::string>;
+using ResponseHandler = std::function<void(Result result)>;
+
+// Handle to an in flight request.
+// Attach a completion with Then(), or co_await it inside a coroutine.
+// If the handle is dropped without either, the response is discarded.
+struct CallHandle {
+  Client* client = nullptr;
+  uint32_t msgid = 0;
+  std::optional<asio::any_io_executor> executor;
+
+  CallHandle() = default;
+  CallHandle(Client* client, uint32_t msgid);
+  CallHandle(const CallHandle&) = delete;
+  CallHandle& operator=(const CallHandle&) = delete;
+  CallHandle(CallHandle&& other);
+  CallHandle& operator=(CallHandle&& other);
+  ~CallHandle();
+
+  bool Valid() const {
+    return client != nullptr;
+  }
+
+  // run completions on executor instead of the rpc thread
+  CallHandle Via(asio::any_io_executor ex) &&;
+  void Then(ResponseHandler&& handler) &&;
+
+  // awaitable, resumes on executor (rpc thread by default).
+  // throws std::runtime_error if nvim returned an error.
+  struct Awaiter {
+    CallHandle& call;
+    std::optional<Result> result;
+
+    bool await_ready() const {
+      return !call.Valid();
+    }
+    bool await_suspend(std::coroutine_handle<> handle);
+    msgpack::object_handle await_resume();
+  };
+  Awaiter operator co_await() && {
+    return {*this, std::nullopt};
+  }
+
+private:
+  void Release();
+};
+
+// Fire and forget coroutine, starts eagerly and frees itself when done.
+// Uncaught exceptions are logged.
+struct Task {
+  struct promise_type {
+    Task get_return_object() {
+      return {};
+    }
+    std::suspend_never initial_suspend() noexcept {
+      return {};
+    }
+    std::suspend_never final_suspend() noexcept {
+      return {};
+    }
+    void return_void() {
+    }
+    void unhandled_exception() {
+      try {
+        throw;
+      } catch (const std::exception& e) {
+        LOG_ERR("rpc::Task: {}", e.what());
+      }
+    }
+  };
+};
+
+} // namespace rpc
@@ -0,0 +1,43 @@
+#include "capture.hpp"
+
+#include <algorithm>
+
+namespace rpc {
+
+bool CaptureWriter::Open(const std::string& path) {
+  file.open(path, std::ios::binary | std::ios::trunc);
+  if (!file) return false;
+  file.write(captureMagic, sizeof(captureMagic));
+  start = std::chrono::steady_clock::now();
+  return bool(file);
+}
+
+void CaptureWriter::Write(const char* data, uint32_t size) {
+  uint64_t time = (std::chrono::steady_clock::now() - start).count();
+  file.write(reinterpret_cast<const char*>(&time), sizeof(time));
+  file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+  file.write(data, size);
+}
+
+bool CaptureReader::Open(const std::string& path) {
+  file.open(path, std::ios::binary);
+  if (!file) return false;
+  char magic[sizeof(captureMagic)];
+  file.read(magic, sizeof(magic));
+  return file && std::ranges::equal(magic, captureMagic);
+}
+
+bool CaptureReader::Next(CaptureChunk& chunk) {
+  uint64_t time;
+  uint32_t size;
+  file.read(reinterpret_cast<char*>(&time), sizeof(time));
+  file.read(reinterpret_cast<char*>(&size), sizeof(size));
+  if (!file) return false;
+
+  chunk.time = std::chrono::nanoseconds(time);
+  chunk.data.resize(size);
+  file.read(chunk.data.data(), size);
+  return bool(file);
+}
+
+} // namespace rpc
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace rpc {
+
+// Capture file of the raw inbound msgpack stream, used for offline replay.
+// Layout: magic, then one record per socket read:
+// [u64 nanoseconds since capture start][u32 size][size bytes]
+inline constexpr char captureMagic[8] = {'N', 'G', 'C', 'A', 'P', '0', '0', '1'};
+
+struct CaptureChunk {
+  std::chrono::nanoseconds time;
+  std::vector<char> data;
+};
+
+struct CaptureWriter {
+  std::ofstream file;
+  std::chrono::steady_clock::time_point start;
+
+  bool Open(const std::string& path);
+  void Write(const char* data, uint32_t size);
+};
+
+struct CaptureReader {
+  std::ifstream file;
+
+  bool Open(const std::string& path);
+  // returns false at end of file
+  bool Next(CaptureChunk& chunk);
+};
+
+} // namespace rpc
@@ -1,34 +1,58 @@
 #include "client.hpp"
 
-#include "asio/connect.hpp"
-#include "asio/write.hpp"
+#include "asio/post.hpp"
+#include "asio/thread_pool.hpp"
 #include "msgpack.hpp"
 
+#include "cursor.hpp"
 #include "messages.hpp"
 #include "utils/logger.hpp"
+#include <algorithm>
+#include <bit>
+#include <format>
 #include <thread>
+#include <utility>
 
 namespace rpc {
 
 Client::~Client() {
-  if (socket.is_open()) socket.close();
+  StopHandlers();
 
-  if (contextThr.joinable()) contextThr.join();
+  {
+    // let queued writes (like ui detach on exit) go out before closing
+    using namespace std::chrono_literals;
+    std::unique_lock lock(writeMutex);
+    writeCv.wait_for(lock, 100ms, [&] { return !writing; });
+  }
+
+  // unblock the reader if it's waiting on a full queue
+  msgsIn.Close();
+
+  if (contextThr.joinable()) {
+    // transport is only touched from the asio thread
+    asio::post(context, [this] { transport->Close(); });
+    contextThr.join();
+  }
   context.stop();
 }
 
-bool Client::Connect(std::string_view host, uint16_t port) {
+bool Client::Connect(const Endpoint& endpoint) {
   asio::error_code ec;
-  asio::ip::tcp::resolver resolver(context);
-  auto endpoints = resolver.resolve(host, std::to_string(port), ec);
-  asio::connect(socket, endpoints, ec);
+  transport = MakeTransport(context, endpoint, ec);
+  if (!ec && injectedDelay.count() > 0) {
+    transport = MakeDelayTransport(context, std::move(transport), injectedDelay);
+  }
 
   if (ec) {
-    socket.close();
+    transport.reset();
     exit = true;
     return false;
   }
   exit = false;
+  {
+    std::scoped_lock lock(responsesMutex);
+    failedError.reset();
+  }
 
   unpacker.reserve_buffer(readSize);
   GetData();
@@ -37,86 +61,232 @@ bool Client::Connect(std::string_view host, uint16_t port) {
   return true;
 }
 
+bool Client::Connect(std::string_view host, uint16_t port) {
+  return Connect(TcpEndpoint{std::string(host), port});
+}
+
 void Client::Disconnect() {
   exit = true;
+  // also stops the reader waiting on a full queue
+  msgsIn.Close();
 }
 
 bool Client::IsConnected() {
   return !exit;
 }
 
+void Client::StopHandlers() {
+  // handlers may be blocked on slow work, queued requests are abandoned
+  workers.stop();
+  workers.join();
+}
+
 // returns next notification at front of queue
 Client::NotificationData Client::PopNotification() {
-  auto msg = std::move(msgsIn.Front());
+  auto msg = std::move(*msgsIn.Front());
   msgsIn.Pop();
+  queuedBytes -= msg.raw.size();
   return msg;
 }
 
+void Client::Recycle(NotificationData&& msg) {
+  if (msg.raw.capacity() == 0 || msg.raw.capacity() > maxRecycleRawSize) return;
+  msg.raw.clear();
+  // dropping when full is fine, a burst just allocates
+  rawFree.TryPush(std::move(msg.raw));
+}
+
+std::vector<char> Client::AcquireRaw() {
+  std::vector<char> raw;
+  if (rawFree.TryPop(raw)) {
+    rawPoolHits.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    rawPoolMisses.fetch_add(1, std::memory_order_relaxed);
+  }
+  return raw;
+}
+
 bool Client::HasNotification() {
   return !msgsIn.Empty();
 }
 
-uint32_t Client::Msgid() {
-  return currId++;
+bool Client::WaitNotification(std::chrono::nanoseconds timeout) {
+  return msgsIn.Wait(timeout);
+}
+
+void Client::WakeWaiter() {
+  msgsIn.Wakeup();
+}
+
+SpscQueueStats Client::NotificationStats() {
+  return msgsIn.Stats();
+}
+
+bool Client::StartCapture(const std::string& path) {
+  auto writer = std::make_unique<CaptureWriter>();
+  if (!writer->Open(path)) {
+    LOG_ERR("Client::StartCapture: Failed to open {}", path);
+    return false;
+  }
+  asio::post(context, [this, writer = std::move(writer)]() mutable {
+    capture = std::move(writer);
+  });
+  return true;
+}
+
+void Client::StopCapture() {
+  asio::post(context, [this] { capture.reset(); });
+}
+
+uint32_t Client::AddPending(Metrics::MethodStats* stats) {
+  std::scoped_lock lock(responsesMutex);
+  uint32_t slot;
+  if (!freeSlots.empty()) {
+    slot = freeSlots.back();
+    freeSlots.pop_back();
+  } else {
+    if (pending.size() > slotMask) {
+      throw std::runtime_error("rpc::Client: too many requests in flight");
+    }
+    slot = pending.size();
+    pending.emplace_back();
+  }
+
+  auto& req = pending[slot];
+  req.msgid = slot | (currId++ << slotBits);
+  req.state = PendingRequest::State::Waiting;
+  req.stats = stats;
+  req.sent = std::chrono::steady_clock::now();
+  // the connection failed after the caller checked it, nothing will answer
+  if (failedError) {
+    req.result = std::unexpected(*failedError);
+    req.state = PendingRequest::State::Done;
+  }
+  return req.msgid;
+}
+
+Client::PendingRequest* Client::FindPending(uint32_t msgid) {
+  uint32_t slot = msgid & slotMask;
+  if (slot >= pending.size()) return nullptr;
+  auto& req = pending[slot];
+  if (req.state == PendingRequest::State::Free || req.msgid != msgid) return nullptr;
+  return &req;
+}
+
+void Client::FreePending(PendingRequest& req) {
+  req.state = PendingRequest::State::Free;
+  req.handler = nullptr;
+  req.result.reset();
+  freeSlots.push_back(req.msgid & slotMask);
+}
+
+std::optional<Result> Client::AttachPending(uint32_t msgid, ResponseHandler& handler) {
+  std::scoped_lock lock(responsesMutex);
+  auto* req = FindPending(msgid);
+  if (req == nullptr) {
+    return Result(std::unexpected("rpc::Client: request not found"));
+  }
+
+  if (req->state == PendingRequest::State::Done) {
+    auto result = std::move(req->result);
+    FreePending(*req);
+    return result;
+  }
+  req->handler = std::move(handler);
+  req->state = PendingRequest::State::Handled;
+  return std::nullopt;
+}
+
+void Client::DetachPending(uint32_t msgid) {
+  std::scoped_lock lock(responsesMutex);
+  auto* req = FindPending(msgid);
+  if (req == nullptr) return;
+
+  if (req->state == PendingRequest::State::Done) {
+    FreePending(*req);
+  } else {
+    req->state = PendingRequest::State::Detached;
+  }
+}
+
+void Client::CompletePending(uint32_t msgid, Result&& result, size_t size) {
+  ResponseHandler handler;
+  {
+    std::scoped_lock lock(responsesMutex);
+    auto* req = FindPending(msgid);
+    if (req == nullptr || req->state == PendingRequest::State::Done) {
+      LOG_WARN("Client::GetData: Response not found for msgid: {}", msgid);
+      return;
+    }
+    metrics.RecordResponse(
+      req->stats, std::chrono::steady_clock::now() - req->sent, size, !result
+    );
+
+    switch (req->state) {
+      case PendingRequest::State::Waiting:
+        req->result = std::move(result);
+        req->state = PendingRequest::State::Done;
+        return;
+      case PendingRequest::State::Handled:
+        handler = std::move(req->handler);
+        FreePending(*req);
+        break;
+      default:
+        FreePending(*req);
+        return;
+    }
+  }
+  // run outside the lock, handler may start new requests
+  handler(std::move(result));
+}
+
+void Client::FailAllPending(const std::string& error) {
+  std::vector<ResponseHandler> handlers;
+  {
+    std::scoped_lock lock(responsesMutex);
+    failedError = error;
+    for (auto& req : pending) {
+      switch (req.state) {
+        case PendingRequest::State::Waiting:
+          req.result = std::unexpected(error);
+          req.state = PendingRequest::State::Done;
+          break;
+        case PendingRequest::State::Handled:
+          handlers.push_back(std::move(req.handler));
+          FreePending(req);
+          break;
+        case PendingRequest::State::Detached:
+          FreePending(req);
+          break;
+        default: break;
+      }
+    }
+  }
+  for (auto& handler : handlers) {
+    handler(std::unexpected(error));
+  }
 }
 
 void Client::GetData() {
   if (!IsConnected()) return;
 
-  socket.async_read_some(
+  transport->AsyncReadSome(
     asio::buffer(unpacker.buffer(), readSize),
     [&](asio::error_code ec, std::size_t length) {
       if (!ec) {
+        if (capture) capture->Write(unpacker.buffer(), length);
         unpacker.buffer_consumed(length);
+        numReads++;
+        numBytesRead += length;
 
-        msgpack::object_handle handle;
-        while (unpacker.next(handle)) {
-          const auto& obj = handle.get();
-          if (obj.type != msgpack::type::ARRAY) {
-            LOG_ERR("Client::GetData: Not an array");
-            continue;
-          }
-
-          int type = obj.via.array.ptr[0].convert();
-          if (type == MessageType::Response) {
-            Response msg(obj.convert());
-
-            auto it = responses.find(msg.msgid);
-            if (it != responses.end()) {
-              auto& promise = it->second;
-              if (msg.error.is_nil()) {
-                promise.set_value(
-                  msgpack::object_handle(msg.result, std::move(handle.zone()))
-                );
-
-              } else {
-                promise.set_exception(std::make_exception_ptr(
-                  std::runtime_error("rpc::Client response error: " + msg.error.via.array.ptr[1].as<std::string>())
-                ));
-              }
-
-              {
-                std::scoped_lock lock(responsesMutex);
-                responses.erase(it);
-              }
-
-            } else {
-              LOG_WARN("Client::GetData: Response not found for msgid: {}", msg.msgid);
-            }
-
-          } else if (type == MessageType::Notification) {
-            NotificationIn msg(obj.convert());
-            msgsIn.Push(NotificationData{
-              .method = msg.method,
-              .params = msg.params,
-              ._zone = std::move(handle.zone()),
-            });
-
-          } else {
-            LOG_WARN("Client::GetData: Unknown type: {}", type);
-          }
+        if (!ReadMessages()) {
+          LOG_ERR("Client::GetData: Invalid msgpack stream");
+          Disconnect();
+          FailAllPending("rpc::Client: invalid msgpack stream");
+          return;
         }
 
+        AdaptReadSize(length);
         if (unpacker.buffer_capacity() < readSize) {
           // LOG("Reserving extra buffer: {}", readSize);
           unpacker.reserve_buffer(readSize);
@@ -126,6 +296,7 @@ void Client::GetData() {
       } else if (ec == asio::error::eof) {
         LOG_INFO("Client::GetData: The server closed the connection");
         Disconnect();
+        FailAllPending("rpc::Client: disconnected");
 
       } else {
         if (IsConnected()) {
@@ -133,38 +304,415 @@ void Client::GetData() {
           // std::cout << "Error message: " << ec.message() << std::endl;
           LOG_ERR("Client::GetData: {}", ec.message());
         }
+        // the connection is gone either way, same as eof
+        Disconnect();
+        FailAllPending("rpc::Client: " + ec.message());
+      }
+    }
+  );
+}
+
+bool Client::ReadMessages() {
+  while (unpacker.nonparsed_size() > 0) {
+    const char* data = unpacker.nonparsed_buffer();
+    size_t size = unpacker.nonparsed_size();
+
+    // find where the message ends before touching it, so the unpacker only
+    // ever sees whole messages
+    size_t end = 0;
+    SkipVisitor skip;
+    if (!msgpack::parse(data, size, end, skip)) {
+      // partial message, it's at least this big
+      windowMaxMsgSize = std::max(windowMaxMsgSize, size);
+      return !skip.error;
+    }
+    windowMaxMsgSize = std::max(windowMaxMsgSize, end);
+    if (end > maxMsgSize) maxMsgSize = end;
+
+    // redraw params are kept encoded, the parse thread decodes them directly
+    // into ui events without building an object tree
+    MsgpackCursor header(data, end);
+    uint32_t length;
+    uint64_t type;
+    std::string_view method;
+    if (header.ReadArrayHeader(length) && length == 3 && header.ReadUint(type) &&
+        type == MessageType::Notification && header.ReadStr(method) &&
+        method == "redraw") {
+      metrics.RecordRedrawIn(end);
+      if (!seenRedraw) {
+        seenRedraw = true;
+        metrics.MarkStartup("first redraw");
+      }
+      NotificationData msg{
+        .method = "redraw",
+        .raw = AcquireRaw(),
+        .received = std::chrono::steady_clock::now(),
+      };
+      msg.raw.assign(data + header.off, data + end);
+      unpacker.skip_nonparsed_buffer(end);
+
+      size_t buffered = (queuedBytes += msg.raw.size()) + unpacker.nonparsed_size();
+      if (buffered > maxBufferedBytes) maxBufferedBytes = buffered;
+
+      // blocks if the parse thread falls msgsInCapacity messages behind
+      if (!msgsIn.Push(std::move(msg))) {
+        queuedBytes -= msg.raw.size(); // not moved from when Push fails
+        LOG_WARN("Client::GetData: Dropped notification: redraw");
+      }
+      continue;
+    }
+
+    msgpack::object_handle handle;
+    if (!unpacker.next(handle)) return false;
+    HandleMessage(handle, end);
+  }
+  return true;
+}
+
+void Client::HandleMessage(msgpack::object_handle& handle, size_t size) {
+  const auto& obj = handle.get();
+  if (obj.type != msgpack::type::ARRAY) {
+    LOG_ERR("Client::GetData: Not an array");
+    return;
+  }
+
+  int type = obj.via.array.ptr[0].convert();
+  if (type == MessageType::Request) {
+    HandleRequest(handle, size);
+
+  } else if (type == MessageType::Response) {
+    Response msg(obj.convert());
+    if (msg.error.is_nil()) {
+      CompletePending(
+        msg.msgid, msgpack::object_handle(msg.result, std::move(handle.zone())), size
+      );
+    } else {
+      CompletePending(
+        msg.msgid, std::unexpected(msg.error.via.array.ptr[1].as<std::string>()), size
+      );
+    }
+
+  } else if (type == MessageType::Notification) {
+    NotificationIn msg(obj.convert());
+    metrics.RecordNotificationIn(msg.method, size);
+    bool pushed = msgsIn.Push(NotificationData{
+      .method = msg.method,
+      .params = msg.params,
+      ._zone = std::move(handle.zone()),
+    });
+    if (!pushed) {
+      LOG_WARN("Client::GetData: Dropped notification: {}", msg.method);
+    }
+
+  } else {
+    LOG_WARN("Client::GetData: Unknown type: {}", type);
+  }
+}
+
+void Client::RegisterHandler(std::string_view method, RequestHandler handler) {
+  std::scoped_lock lock(handlersMutex);
+  handlers.insert_or_assign(std::string(method), std::move(handler));
+}
+
+void Client::HandleRequest(msgpack::object_handle& handle, size_t size) {
+  RequestIn msg(handle.get().convert());
+  auto* stats = metrics.RecordRequestIn(msg.method, size);
+
+  RequestHandler handler;
+  {
+    std::scoped_lock lock(handlersMutex);
+    auto it = handlers.find(msg.method);
+    if (it != handlers.end()) handler = it->second;
+  }
+
+  if (!handler) {
+    LOG_WARN("Client::HandleRequest: No handler for {}", msg.method);
+    Reply reply(AcquireBuffer(), msg.msgid);
+    reply.Error(std::format("neogui: no handler for {}", msg.method));
+    metrics.RecordReply(stats, {}, reply.buffer.size(), true);
+    Write(std::move(reply.buffer));
+    return;
+  }
+
+  // params live in the zone, which moves into the worker along with them
+  asio::post(
+    workers,
+    [this, handler = std::move(handler), stats, msgid = msg.msgid, params = msg.params,
+     zone = std::move(handle.zone()), start = std::chrono::steady_clock::now()] {
+      Reply reply(AcquireBuffer(), msgid);
+      bool error = false;
+      try {
+        handler(params, reply);
+        if (!reply.replied) {
+          reply.Error("neogui: handler returned no result");
+          error = true;
+        }
+      } catch (const std::exception& e) {
+        LOG_ERR("Client::HandleRequest: {}", e.what());
+        reply.Error(e.what());
+        error = true;
+      } catch (...) {
+        // an escaping exception would terminate the worker pool
+        LOG_ERR("Client::HandleRequest: unknown exception");
+        reply.Error("neogui: unknown exception");
+        error = true;
       }
+
+      metrics.RecordReply(
+        stats, std::chrono::steady_clock::now() - start, reply.buffer.size(), error
+      );
+      Write(std::move(reply.buffer));
     }
   );
 }
 
+void Client::AdaptReadSize(size_t length) {
+  // the transport had more data than we asked for
+  if (length == readSize) {
+    readSize = std::min(readSize * 2, maxReadSize);
+    windowFilled = true;
+  }
+
+  // fit the biggest message seen recently in a single read
+  size_t target = std::clamp(std::bit_ceil(windowMaxMsgSize), minReadSize, maxReadSize);
+  if (target > readSize) readSize = target;
+
+  if (++windowReads == readWindow) {
+    if (!windowFilled && target < readSize) {
+      readSize = std::max(target, readSize / 2);
+    }
+    windowReads = 0;
+    windowMaxMsgSize = 0;
+    windowFilled = false;
+  }
+
+  currReadSize = readSize;
+  if (readSize > peakReadSize) peakReadSize = readSize;
+}
+
+msgpack::sbuffer Client::AcquireBuffer() {
+  std::scoped_lock lock(writeMutex);
+  if (freeBuffers.empty()) return {};
+  auto buffer = std::move(freeBuffers.back());
+  freeBuffers.pop_back();
+  return buffer;
+}
+
+bool Client::WaitWriteQueue(size_t maxBytes, std::chrono::nanoseconds timeout) {
+  std::unique_lock lock(writeMutex);
+  return writeCv.wait_for(lock, timeout, [&] {
+    return pendingWriteBytes <= maxBytes || !IsConnected();
+  });
+}
+
+size_t Client::PendingWriteBytes() {
+  std::scoped_lock lock(writeMutex);
+  return pendingWriteBytes;
+}
+
 void Client::Write(msgpack::sbuffer&& buffer) {
-  msgsOut.Push(std::move(buffer));
-  if (msgsOut.Size() > 1) return;
-  DoWrite();
+  std::scoped_lock lock(writeMutex);
+  pendingWriteBytes += buffer.size();
+  msgsOut.push_back(std::move(buffer));
+  if (writing) return;
+
+  // writes are only started from the asio thread
+  writing = true;
+  asio::post(context, MakeAllocHandler(writeStartMemory, [this] { DoWrite(); }));
 }
 
 void Client::DoWrite() {
-  // send all messages before exiting
-  if (msgsOut.Empty()) return;
-  auto& buffer = msgsOut.Front();
-  asio::async_write(
-    socket, asio::buffer(buffer.data(), buffer.size()),
-    [&](const asio::error_code& ec, size_t length) {
-      (void)length;
-      if (!ec) {
-        if (msgsOut.Empty()) {
-          LOG_WARN("Client::DoWrite: msgsOut is empty");
-          return;
-        }
-        msgsOut.Pop();
-        DoWrite();
+  {
+    std::scoped_lock lock(writeMutex);
+    if (msgsOut.empty()) {
+      writing = false;
+      writeCv.notify_all();
+      return;
+    }
+    std::swap(writeBatch, msgsOut);
+  }
 
-      } else {
+  writeBufs.clear();
+  for (auto& buffer : writeBatch) {
+    writeBufs.emplace_back(buffer.data(), buffer.size());
+  }
+
+  transport->AsyncWrite(
+    writeBufs,
+    [this](const asio::error_code& ec, size_t length) {
+      if (ec) {
         LOG_ERR("Client::DoWrite: {}", ec.message());
+        std::scoped_lock lock(writeMutex);
+        for (auto& buffer : writeBatch) {
+          pendingWriteBytes -= buffer.size();
+        }
+        writeBatch.clear();
+        writing = false;
+        writeCv.notify_all();
+        return;
+      }
+
+      size_t numMsgs = writeBatch.size();
+      numWrites++;
+      numMsgsWritten += numMsgs;
+      numBytesWritten += length;
+      if (numMsgs > maxMsgsPerWrite) maxMsgsPerWrite = numMsgs;
+      if (length > maxBytesPerWrite) maxBytesPerWrite = length;
+
+      {
+        std::scoped_lock lock(writeMutex);
+        pendingWriteBytes -= length;
+        writeCv.notify_all();
+        for (auto& buffer : writeBatch) {
+          if (freeBuffers.size() >= maxFreeBuffers) break;
+          // don't hold on to big one off buffers
+          if (buffer.size() > maxRecycleSize) continue;
+          buffer.clear();
+          freeBuffers.push_back(std::move(buffer));
+        }
+        writeBatch.clear();
       }
+
+      DoWrite();
     }
   );
 }
 
+Client::WriteStats Client::GetWriteStats() {
+  return {
+    .writes = numWrites,
+    .messages = numMsgsWritten,
+    .bytes = numBytesWritten,
+    .maxMessagesPerWrite = maxMsgsPerWrite,
+    .maxBytesPerWrite = maxBytesPerWrite,
+  };
+}
+
+Client::ReadStats Client::GetReadStats() {
+  return {
+    .reads = numReads,
+    .bytes = numBytesRead,
+    .readSize = currReadSize,
+    .maxReadSize = peakReadSize,
+    .maxMessageSize = maxMsgSize,
+    .bufferedBytes = queuedBytes,
+    .maxBufferedBytes = maxBufferedBytes,
+    .poolHits = rawPoolHits,
+    .poolMisses = rawPoolMisses,
+  };
+}
+
+std::string Client::DumpMetrics() {
+  auto out = metrics.Dump();
+  auto writeStats = GetWriteStats();
+  out += std::format(
+    "writes {} ({} messages, max {} messages / {} bytes per write)\n", writeStats.writes,
+    writeStats.messages, writeStats.maxMessagesPerWrite, writeStats.maxBytesPerWrite
+  );
+  auto readStats = GetReadStats();
+  out += std::format(
+    "reads {} ({} KB), read size {} KB (max {} KB), largest message {} KB\n",
+    readStats.reads, readStats.bytes >> 10, readStats.readSize >> 10,
+    readStats.maxReadSize >> 10, readStats.maxMessageSize >> 10
+  );
+  out += std::format(
+    "buffered {} KB (peak {} KB), redraw buffer pool {} hits {} misses\n",
+    readStats.bufferedBytes >> 10, readStats.maxBufferedBytes >> 10,
+    readStats.poolHits, readStats.poolMisses
+  );
+  auto queueStats = msgsIn.Stats();
+  out += std::format(
+    "notification queue depth {} (max {}), reader waited on full queue {} times\n",
+    queueStats.depth, queueStats.maxDepth, queueStats.fullWaits
+  );
+  return out;
+}
+
+// CallHandle --------------------------------------------------------
+CallHandle::CallHandle(Client* _client, uint32_t _msgid)
+    : client(_client), msgid(_msgid) {
+}
+
+CallHandle::CallHandle(CallHandle&& other)
+    : client(std::exchange(other.client, nullptr)), msgid(other.msgid),
+      executor(std::move(other.executor)) {
+}
+
+CallHandle& CallHandle::operator=(CallHandle&& other) {
+  if (this != &other) {
+    Release();
+    client = std::exchange(other.client, nullptr);
+    msgid = other.msgid;
+    executor = std::move(other.executor);
+  }
+  return *this;
+}
+
+CallHandle::~CallHandle() {
+  Release();
+}
+
+void CallHandle::Release() {
+  if (client) client->DetachPending(msgid);
+  client = nullptr;
+}
+
+CallHandle CallHandle::Via(asio::any_io_executor ex) && {
+  executor = std::move(ex);
+  return std::move(*this);
+}
+
+void CallHandle::Then(ResponseHandler&& handler) && {
+  if (!Valid()) {
+    handler(std::unexpected("rpc::Client: not connected"));
+    return;
+  }
+
+  if (executor) {
+    handler = [ex = *executor, h = std::move(handler)](Result result) {
+      asio::post(ex, [h, result = std::move(result)]() mutable {
+        h(std::move(result));
+      });
+    };
+  }
+
+  auto* c = std::exchange(client, nullptr);
+  if (auto result = c->AttachPending(msgid, handler)) {
+    handler(std::move(*result));
+  }
+}
+
+bool CallHandle::Awaiter::await_suspend(std::coroutine_handle<> handle) {
+  ResponseHandler resume = [this, handle](Result r) {
+    result = std::move(r);
+    handle.resume();
+  };
+  if (call.executor) {
+    resume = [ex = *call.executor, resume](Result r) {
+      asio::post(ex, [resume, r = std::move(r)]() mutable {
+        resume(std::move(r));
+      });
+    };
+  }
+
+  // coroutine may be resumed on another thread as soon as the handler is
+  // attached, so don't touch call after that
+  auto* c = std::exchange(call.client, nullptr);
+  if (auto early = c->AttachPending(call.msgid, resume)) {
+    result = std::move(*early);
+    return false;
+  }
+  return true;
+}
+
+msgpack::object_handle CallHandle::Awaiter::await_resume() {
+  if (!result) {
+    throw std::runtime_error("rpc::Client: not connected");
+  }
+  if (!*result) {
+    throw std::runtime_error("rpc::Client response error: " + result->error());
+  }
+  return std::move(**result);
+}
+
 } // namespace rpc
@@ -2,31 +2,48 @@
 
 #include "msgpack.hpp"
 #include "asio/io_context.hpp"
-#include "asio/ip/tcp.hpp"
+#include "asio/buffer.hpp"
+#include "asio/thread_pool.hpp"
 
 #include "nvim/msgpack_rpc/messages.hpp"
-#include "tsqueue.hpp"
+#include "call.hpp"
+#include "capture.hpp"
+#include "handler.hpp"
+#include "metrics.hpp"
+#include "transport.hpp"
+#include "handler_memory.hpp"
+#include "spsc_queue.hpp"
 
-#include <string_view>
+#include <optional>
+#include <semaphore>
+#include <string>
 #include <unordered_map>
-#include <future>
+#include <thread>
+#include <string_view>
+#include <vector>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
 
 namespace rpc {
 
 struct Client {
 private:
   asio::io_context context;
-  asio::ip::tcp::socket socket{context};
+  std::unique_ptr<Transport> transport;
   std::thread contextThr;
   std::atomic_bool exit;
-  std::unordered_map<u_int32_t, std::promise<msgpack::object_handle>> responses;
-  std::mutex responsesMutex;
 
 public:
   struct NotificationData {
     std::string_view method;
     msgpack::object params;
     msgpack::unique_ptr<msgpack::zone> _zone; // holds the lifetime of the data
+    // encoded params, set instead of params for redraw notifications
+    // so they can be decoded straight into ui events (see ParseUiEvent)
+    std::vector<char> raw;
+    // when a redraw came off the socket, for apply latency
+    std::chrono::steady_clock::time_point received;
   };
 
   Client() = default;
@@ -34,28 +51,196 @@ public:
   Client& operator=(const Client&) = delete;
   ~Client();
 
+  // added to each direction of the connection (see MakeDelayTransport),
+  // set before Connect
+  std::chrono::nanoseconds injectedDelay{};
+
+  bool Connect(const Endpoint& endpoint);
   bool Connect(std::string_view host, uint16_t port);
   void Disconnect();
   bool IsConnected();
+  // waits for running request handlers and drops queued ones,
+  // for owners of state captured by a handler. later requests aren't run
+  void StopHandlers();
+
+  // blocks until response, throws std::runtime_error on error.
+  // don't call from the rpc thread.
+  // args are packed in place, by reference
+  msgpack::object_handle Call(std::string_view method, const auto&... args);
+  CallHandle AsyncCall(std::string_view func_name, const auto&... args);
+  void Send(std::string_view func_name, const auto&... args);
+  // for hot notifications, the header is copied instead of packed.
+  // nothing is allocated once the buffer pool is warm
+  template <size_t NumArgs>
+  void Send(const NotificationPrefix<NumArgs>& prefix, const auto&... args);
 
-  msgpack::object_handle Call(std::string_view method, auto... args);
-  std::future<msgpack::object_handle>
-  AsyncCall(std::string_view func_name, auto... args);
-  void Send(std::string_view func_name, auto... args);
+  struct WriteStats {
+    size_t writes;   // number of async_write calls
+    size_t messages; // messages sent
+    size_t bytes;    // bytes sent
+    size_t maxMessagesPerWrite;
+    size_t maxBytesPerWrite;
+  };
+  WriteStats GetWriteStats();
+
+  // bytes queued or in flight in the writer
+  size_t PendingWriteBytes();
+  // blocks until at most maxBytes are queued or in flight, for producers that
+  // want backpressure (large pastes). returns false on timeout
+  bool WaitWriteQueue(size_t maxBytes, std::chrono::nanoseconds timeout);
+
+  struct ReadStats {
+    size_t reads;             // number of async_read_some completions
+    size_t bytes;             // bytes received
+    size_t readSize;          // current receive size
+    size_t maxReadSize;       // largest receive size used
+    size_t maxMessageSize;    // largest single message seen
+    size_t bufferedBytes;     // received but not yet consumed by the parse thread
+    size_t maxBufferedBytes;  // high water mark of bufferedBytes
+    size_t poolHits;          // redraw buffers reused
+    size_t poolMisses;        // redraw buffers allocated
+  };
+  ReadStats GetReadStats();
 
   // returns next notification at front of queue
   NotificationData PopNotification();
+  // hands a consumed notification's buffer back to the reader for reuse,
+  // call from the same thread as PopNotification
+  void Recycle(NotificationData&& msg);
   bool HasNotification();
+  // blocks until a notification arrives, WakeWaiter() is called or timeout elapses
+  bool WaitNotification(std::chrono::nanoseconds timeout);
+  void WakeWaiter();
+  SpscQueueStats NotificationStats();
+
+  // answer requests (rpcrequest) from nvim, handlers run on a worker pool.
+  // replaces any handler already registered for method
+  void RegisterHandler(std::string_view method, RequestHandler handler);
+
+  // per method counters and latencies, see metrics.hpp
+  Metrics metrics;
+  // metrics table plus writer and notification queue stats
+  std::string DumpMetrics();
+
+  // records the raw inbound byte stream, replay with ReplayEndpoint
+  bool StartCapture(const std::string& path);
+  void StopCapture();
 
 private:
+  std::unique_ptr<CaptureWriter> capture; // asio thread only
   msgpack::unpacker unpacker;
-  static constexpr std::size_t readSize = 1024 << 10;
-  TSQueue<NotificationData> msgsIn;
-  TSQueue<msgpack::sbuffer> msgsOut;
+
+  // receive size grows when a read fills the buffer or a bigger message shows up,
+  // and shrinks back after readWindow reads of smaller traffic
+  static constexpr size_t minReadSize = 64 << 10;
+  static constexpr size_t maxReadSize = 16 << 20;
+  static constexpr size_t readWindow = 256;
+  size_t readSize = minReadSize; // asio thread only
+  bool seenRedraw = false;        // asio thread only
+  size_t windowReads = 0;
+  size_t windowMaxMsgSize = 0;
+  bool windowFilled = false;
+  void AdaptReadSize(size_t length);
+
+  // produced by the asio thread, consumed by the parse thread (see Nvim)
+  static constexpr std::size_t msgsInCapacity = 4096;
+  SpscQueue<NotificationData> msgsIn{msgsInCapacity};
+  // parsed redraw buffers flowing back from the parse thread,
+  // so steady state reading doesn't allocate. bigger buffers are freed,
+  // so the pool holds at most maxFreeRaw * maxRecycleRawSize (4 MiB)
+  static constexpr size_t maxRecycleRawSize = 64 << 10;
+  static constexpr size_t maxFreeRaw = 64;
+  SpscQueue<std::vector<char>> rawFree{maxFreeRaw};
+  std::vector<char> AcquireRaw();
+
+  std::atomic_size_t numReads = 0;
+  std::atomic_size_t numBytesRead = 0;
+  std::atomic_size_t currReadSize = minReadSize;
+  std::atomic_size_t peakReadSize = minReadSize;
+  std::atomic_size_t maxMsgSize = 0;
+  std::atomic_size_t queuedBytes = 0; // redraw bytes in msgsIn
+  std::atomic_size_t maxBufferedBytes = 0;
+  std::atomic_size_t rawPoolHits = 0;
+  std::atomic_size_t rawPoolMisses = 0;
+  // in flight requests, slab indexed by the low bits of the msgid,
+  // high bits are a generation to catch stale or duplicate responses
+  struct PendingRequest {
+    enum class State : uint8_t {
+      Free,
+      Waiting, // no completion attached yet
+      Handled, // completion attached
+      Done,    // response arrived before completion was attached
+      Detached // handle dropped, discard response
+    };
+    uint32_t msgid;
+    State state = State::Free;
+    Metrics::MethodStats* stats;
+    std::chrono::steady_clock::time_point sent;
+    ResponseHandler handler;
+    std::optional<Result> result;
+  };
+  static constexpr uint32_t slotBits = 16;
+  static constexpr uint32_t slotMask = (1u << slotBits) - 1;
+  std::mutex responsesMutex;
+  std::vector<PendingRequest> pending;
+  // set by FailAllPending, requests added after it fail straight away
+  std::optional<std::string> failedError;
+  std::vector<uint32_t> freeSlots;
   uint32_t currId = 0;
 
-  uint32_t Msgid();
+  friend struct CallHandle;
+  uint32_t AddPending(Metrics::MethodStats* stats);
+  PendingRequest* FindPending(uint32_t msgid); // hold responsesMutex
+  void FreePending(PendingRequest& req);       // hold responsesMutex
+  // returns result without consuming handler if response already arrived
+  std::optional<Result> AttachPending(uint32_t msgid, ResponseHandler& handler);
+  void DetachPending(uint32_t msgid);
+  // size is the encoded size of the response
+  void CompletePending(uint32_t msgid, Result&& result, size_t size);
+  void FailAllPending(const std::string& error);
+
+  // requests from nvim
+  static constexpr size_t numWorkers = 2;
+  std::mutex handlersMutex;
+  // looked up by string_view, so a request doesn't allocate
+  struct StringHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view s) const {
+      return std::hash<std::string_view>{}(s);
+    }
+  };
+  std::unordered_map<std::string, RequestHandler, StringHash, std::equal_to<>>
+    handlers;
+  asio::thread_pool workers{numWorkers};
+  void HandleRequest(msgpack::object_handle& handle, size_t size);
+
+  // outgoing messages are batched, every message queued while a write is in
+  // flight gets sent together in a single scatter-gather write
+  std::mutex writeMutex;
+  std::condition_variable writeCv; // notified after every write completes
+  bool writing = false;
+  size_t pendingWriteBytes = 0;
+  std::vector<msgpack::sbuffer> msgsOut;     // queued, guarded by writeMutex
+  std::vector<msgpack::sbuffer> writeBatch;  // in flight
+  std::vector<asio::const_buffer> writeBufs; // views into writeBatch
+  std::vector<msgpack::sbuffer> freeBuffers; // recycled, guarded by writeMutex
+  // the DoWrite post from Write(), only one is queued at a time
+  HandlerMemory writeStartMemory;
+  static constexpr size_t maxFreeBuffers = 64;
+  static constexpr size_t maxRecycleSize = 64 << 10;
+
+  std::atomic_size_t numWrites = 0;
+  std::atomic_size_t numMsgsWritten = 0;
+  std::atomic_size_t numBytesWritten = 0;
+  std::atomic_size_t maxMsgsPerWrite = 0;
+  std::atomic_size_t maxBytesPerWrite = 0;
+
   void GetData();
+  // handles all complete messages in the unpacker buffer,
+  // returns false if the stream is corrupt
+  bool ReadMessages();
+  void HandleMessage(msgpack::object_handle& handle, size_t size);
+  msgpack::sbuffer AcquireBuffer();
   void Write(msgpack::sbuffer&& buffer);
   void DoWrite();
 };
@@ -64,44 +249,73 @@ private:
 
 namespace rpc {
 
-msgpack::object_handle Client::Call(std::string_view method, auto... args) {
-  auto future = AsyncCall(method, args...);
-  return future.get();
+msgpack::object_handle Client::Call(std::string_view method, const auto&... args) {
+  auto call = AsyncCall(method, args...);
+  if (!call.Valid()) {
+    throw std::runtime_error("rpc::Client::Call: not connected");
+  }
+
+  std::binary_semaphore done(0);
+  std::optional<Result> result;
+  std::move(call).Then([&](Result r) {
+    result = std::move(r);
+    done.release();
+  });
+  done.acquire();
+
+  if (!*result) {
+    throw std::runtime_error("rpc::Client response error: " + result->error());
+  }
+  return std::move(**result);
 }
 
-std::future<msgpack::object_handle>
-Client::AsyncCall(std::string_view func_name, auto... args) {
+CallHandle Client::AsyncCall(std::string_view func_name, const auto&... args) {
   if (!IsConnected()) return {};
 
-  Request msg{
-    .msgid = Msgid(),
-    .method = func_name,
-    .params = std::tuple(args...),
-  };
-  msgpack::sbuffer buffer;
-  msgpack::pack(buffer, msg);
+  auto* stats = metrics.RecordRequest(func_name);
+  uint32_t msgid = AddPending(stats);
+
+  auto buffer = AcquireBuffer();
+  msgpack::packer<msgpack::sbuffer> packer(buffer);
+  packer.pack_array(4);
+  packer.pack(int32_t(MessageType::Request));
+  packer.pack(msgid);
+  packer.pack(func_name);
+  packer.pack_array(sizeof...(args));
+  (packer.pack(args), ...);
+
+  metrics.RecordBytesOut(stats, buffer.size());
   Write(std::move(buffer));
 
-  std::promise<msgpack::object_handle> promise;
-  auto future = promise.get_future();
-  {
-    std::scoped_lock lock(responsesMutex);
-    responses[msg.msgid] = std::move(promise);
-  }
+  return {this, msgid};
+}
+
+void Client::Send(std::string_view func_name, const auto&... args) {
+  if (!IsConnected()) return;
 
-  return future;
+  auto buffer = AcquireBuffer();
+  msgpack::packer<msgpack::sbuffer> packer(buffer);
+  packer.pack_array(3);
+  packer.pack(int32_t(MessageType::Notification));
+  packer.pack(func_name);
+  packer.pack_array(sizeof...(args));
+  (packer.pack(args), ...);
+
+  metrics.RecordNotificationOut(func_name, buffer.size());
+  Write(std::move(buffer));
 }
 
-void Client::Send(std::string_view func_name, auto... args) {
+template <size_t NumArgs>
+void Client::Send(const NotificationPrefix<NumArgs>& prefix, const auto&... args) {
+  static_assert(sizeof...(args) == NumArgs, "argument count doesn't match the prefix");
   if (!IsConnected()) return;
 
-  // template required for Apple Clang
-  NotificationOut msg{
-    .method = func_name,
-    .params = std::tuple(args...),
-  };
-  msgpack::sbuffer buffer;
-  msgpack::pack(buffer, msg);
+  auto buffer = AcquireBuffer();
+  buffer.write(prefix.data.data(), prefix.size);
+  msgpack::packer<msgpack::sbuffer> packer(buffer);
+  (packer.pack(args), ...);
+
+  metrics.RecordNotificationOut(prefix.method, buffer.size());
   Write(std::move(buffer));
 }
 
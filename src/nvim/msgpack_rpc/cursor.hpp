@@ -0,0 +1,216 @@
+#pragma once
+
+#include "msgpack.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace rpc {
+
+// Skips over one object, remembers why parsing stopped.
+struct SkipVisitor : msgpack::null_visitor {
+  bool error = false;
+  bool partial = false;
+
+  void parse_error(size_t, size_t) {
+    error = true;
+  }
+  void insufficient_bytes(size_t, size_t) {
+    partial = true;
+  }
+};
+
+// Forward only reader over encoded msgpack, for walking message framing
+// without building an object tree.
+// Read functions return false (and don't advance) on a type mismatch or
+// truncated input.
+struct MsgpackCursor {
+  const char* data;
+  size_t size;
+  size_t off = 0;
+
+  MsgpackCursor(const char* _data, size_t _size) : data(_data), size(_size) {
+  }
+
+  bool AtEnd() const {
+    return off >= size;
+  }
+  size_t Remaining() const {
+    return size - off;
+  }
+
+  bool ReadArrayHeader(uint32_t& count) {
+    if (AtEnd()) return false;
+    auto b = static_cast<uint8_t>(data[off]);
+    if ((b & 0xf0) == 0x90) {
+      count = b & 0x0f;
+      off += 1;
+      return true;
+    }
+    if (b == 0xdc) return ReadBigEndian<uint16_t>(1, count);
+    if (b == 0xdd) return ReadBigEndian<uint32_t>(1, count);
+    return false;
+  }
+
+  bool ReadUint(uint64_t& value) {
+    if (AtEnd()) return false;
+    auto b = static_cast<uint8_t>(data[off]);
+    if (b <= 0x7f) {
+      value = b;
+      off += 1;
+      return true;
+    }
+    if (b == 0xcc) return ReadBigEndian<uint8_t>(1, value);
+    if (b == 0xcd) return ReadBigEndian<uint16_t>(1, value);
+    if (b == 0xce) return ReadBigEndian<uint32_t>(1, value);
+    if (b == 0xcf) return ReadBigEndian<uint64_t>(1, value);
+    return false;
+  }
+
+  // str points into the underlying buffer
+  bool ReadStr(std::string_view& str) {
+    if (AtEnd()) return false;
+    auto b = static_cast<uint8_t>(data[off]);
+    size_t start = off;
+    uint32_t length;
+    if ((b & 0xe0) == 0xa0) {
+      length = b & 0x1f;
+      off += 1;
+    } else if (b == 0xd9) {
+      if (!ReadBigEndian<uint8_t>(1, length)) return false;
+    } else if (b == 0xda) {
+      if (!ReadBigEndian<uint16_t>(1, length)) return false;
+    } else if (b == 0xdb) {
+      if (!ReadBigEndian<uint32_t>(1, length)) return false;
+    } else {
+      return false;
+    }
+    if (Remaining() < length) {
+      off = start;
+      return false;
+    }
+    str = std::string_view(data + off, length);
+    off += length;
+    return true;
+  }
+
+  // skips one whole object, only headers are read so skipping
+  // large arrays costs a few bytes per item
+  bool Skip() {
+    size_t start = off;
+    uint64_t pending = 1; // objects left to skip, containers add their items
+    while (pending > 0) {
+      pending--;
+      if (!SkipHeader(pending)) {
+        off = start;
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // feeds the next object to a msgpack visitor (see msgpack::null_visitor)
+  template <typename Visitor>
+  bool Parse(Visitor& visitor) {
+    return msgpack::parse(data, size, off, visitor);
+  }
+
+  // unpacks the next object into zone, throws msgpack exceptions like unpack
+  msgpack::object Unpack(msgpack::zone& zone) {
+    return msgpack::unpack(zone, data, size, off);
+  }
+
+private:
+  // skips the header of one object along with its payload,
+  // adds the items of arrays and maps to pending
+  bool SkipHeader(uint64_t& pending) {
+    if (AtEnd()) return false;
+    auto b = static_cast<uint8_t>(data[off]);
+    uint32_t length = 0;
+    size_t skip = 0; // payload past the header
+    if (b <= 0x7f || b >= 0xe0 || (b >= 0xc0 && b <= 0xc3 && b != 0xc1)) {
+      off += 1;
+      return true;
+    }
+    if ((b & 0xf0) == 0x80) {
+      pending += (b & 0x0f) * 2;
+      off += 1;
+      return true;
+    }
+    if ((b & 0xf0) == 0x90) {
+      pending += b & 0x0f;
+      off += 1;
+      return true;
+    }
+    if ((b & 0xe0) == 0xa0) {
+      off += 1;
+      skip = b & 0x1f;
+    } else {
+      switch (b) {
+        // fixed size: float, uint, int, fixext
+        case 0xca: case 0xce: case 0xd2: skip = 5; break;
+        case 0xcb: case 0xcf: case 0xd3: skip = 9; break;
+        case 0xcc: case 0xd0: skip = 2; break;
+        case 0xcd: case 0xd1: skip = 3; break;
+        case 0xd4: skip = 3; break;
+        case 0xd5: skip = 4; break;
+        case 0xd6: skip = 6; break;
+        case 0xd7: skip = 10; break;
+        case 0xd8: skip = 18; break;
+        // str, bin
+        case 0xc4: case 0xd9:
+          if (!ReadBigEndian<uint8_t>(1, length)) return false;
+          break;
+        case 0xc5: case 0xda:
+          if (!ReadBigEndian<uint16_t>(1, length)) return false;
+          break;
+        case 0xc6: case 0xdb:
+          if (!ReadBigEndian<uint32_t>(1, length)) return false;
+          break;
+        // ext, length doesn't count the type byte
+        case 0xc7:
+          if (!ReadBigEndian<uint8_t>(1, length)) return false;
+          length++;
+          break;
+        case 0xc8:
+          if (!ReadBigEndian<uint16_t>(1, length)) return false;
+          length++;
+          break;
+        case 0xc9:
+          if (!ReadBigEndian<uint32_t>(1, length)) return false;
+          skip = 1;
+          break;
+        // array, map
+        case 0xdc: case 0xdd: case 0xde: case 0xdf:
+          if (!(b & 1 ? ReadBigEndian<uint32_t>(1, length)
+                      : ReadBigEndian<uint16_t>(1, length))) {
+            return false;
+          }
+          pending += b >= 0xde ? uint64_t(length) * 2 : length;
+          return true;
+        default: return false; // 0xc1, never used
+      }
+    }
+    skip += length;
+    if (Remaining() < skip) return false;
+    off += skip;
+    return true;
+  }
+
+  // reads a big endian T located skip bytes past off, advances past both
+  template <typename T, typename Out>
+  bool ReadBigEndian(size_t skip, Out& out) {
+    if (Remaining() < skip + sizeof(T)) return false;
+    const auto* p = reinterpret_cast<const uint8_t*>(data + off + skip);
+    uint64_t value = 0;
+    for (size_t i = 0; i < sizeof(T); i++) {
+      value = (value << 8) | p[i];
+    }
+    out = static_cast<Out>(value);
+    off += skip + sizeof(T);
+    return true;
+  }
+};
+
+} // namespace rpc
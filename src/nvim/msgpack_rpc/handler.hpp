@@ -0,0 +1,63 @@
+#pragma once
+
+#include "msgpack.hpp"
+#include "messages.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <string_view>
+
+namespace rpc {
+
+// Response to a request from nvim, handlers set exactly one of Result() or Error().
+// Packs straight into the outgoing message buffer.
+struct Reply {
+  msgpack::sbuffer buffer;
+  msgpack::packer<msgpack::sbuffer> packer{buffer};
+  bool replied = false;
+
+  Reply(msgpack::sbuffer&& _buffer, uint32_t _msgid)
+      : buffer(std::move(_buffer)), msgid(_msgid) {
+    PackHeader();
+  }
+  Reply(const Reply&) = delete;
+  Reply& operator=(const Reply&) = delete;
+
+  // if packing value throws, the buffer goes back to just the header
+  // so Error() can still be sent
+  template <typename T>
+  void Result(const T& value) {
+    if (replied) return;
+    packer.pack_nil();
+    try {
+      packer.pack(value);
+    } catch (...) {
+      buffer.clear();
+      PackHeader();
+      throw;
+    }
+    replied = true;
+  }
+
+  void Error(std::string_view message) {
+    if (replied) return;
+    replied = true;
+    packer.pack(message);
+    packer.pack_nil();
+  }
+
+private:
+  uint32_t msgid;
+
+  void PackHeader() {
+    packer.pack_array(4);
+    packer.pack(int32_t(MessageType::Response));
+    packer.pack(msgid);
+  }
+};
+
+// Runs on the client's worker pool, never on the rpc thread, so it can block.
+// params stays valid for the duration of the call.
+using RequestHandler = std::function<void(const msgpack::object& params, Reply& reply)>;
+
+} // namespace rpc
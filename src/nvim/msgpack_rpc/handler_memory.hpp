@@ -0,0 +1,85 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <new>
+#include <utility>
+
+namespace rpc {
+
+// Fixed storage for a handler that's only ever queued once at a time.
+// asio recycles handler memory on its own threads, but handlers posted from
+// any other thread go through operator new, this keeps those off the heap.
+// Falls back to the heap if the storage is busy or too small.
+struct HandlerMemory {
+  alignas(std::max_align_t) std::array<std::byte, 256> storage;
+  bool inUse = false;
+
+  HandlerMemory() = default;
+  HandlerMemory(const HandlerMemory&) = delete;
+  HandlerMemory& operator=(const HandlerMemory&) = delete;
+
+  void* Allocate(size_t size) {
+    if (!inUse && size <= storage.size()) {
+      inUse = true;
+      return storage.data();
+    }
+    return ::operator new(size);
+  }
+
+  void Deallocate(void* pointer) {
+    if (pointer == storage.data()) {
+      inUse = false;
+    } else {
+      ::operator delete(pointer);
+    }
+  }
+};
+
+template <typename T>
+struct HandlerAllocator {
+  using value_type = T;
+  HandlerMemory* memory;
+
+  explicit HandlerAllocator(HandlerMemory& _memory) : memory(&_memory) {
+  }
+  template <typename U>
+  HandlerAllocator(const HandlerAllocator<U>& other) : memory(other.memory) {
+  }
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(memory->Allocate(sizeof(T) * n));
+  }
+  void deallocate(T* pointer, size_t) {
+    memory->Deallocate(pointer);
+  }
+
+  template <typename U>
+  bool operator==(const HandlerAllocator<U>& other) const {
+    return memory == other.memory;
+  }
+};
+
+// handler whose memory comes from a HandlerMemory (asio picks up allocator_type)
+template <typename Handler>
+struct AllocHandler {
+  using allocator_type = HandlerAllocator<Handler>;
+  HandlerMemory& memory;
+  Handler handler;
+
+  allocator_type get_allocator() const {
+    return allocator_type(memory);
+  }
+
+  template <typename... Args>
+  void operator()(Args&&... args) {
+    handler(std::forward<Args>(args)...);
+  }
+};
+
+template <typename Handler>
+AllocHandler<Handler> MakeAllocHandler(HandlerMemory& memory, Handler&& handler) {
+  return {memory, std::forward<Handler>(handler)};
+}
+
+} // namespace rpc
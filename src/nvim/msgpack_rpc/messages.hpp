@@ -1,6 +1,11 @@
 #pragma once
 
 #include "msgpack.hpp"
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <string_view>
+#include <vector>
 
 namespace rpc {
 
@@ -12,15 +17,35 @@ struct MessageType {
   };
 };
 
-template <typename T>
-struct Request {
-  int32_t type = MessageType::Request;
-  uint32_t msgid;
+// [2, method, [ of a notification with NumArgs arguments, packed at compile time
+// for hot methods so sending one only packs the arguments (see Client::Send)
+template <size_t NumArgs>
+struct NotificationPrefix {
+  static constexpr size_t numArgs = NumArgs;
   std::string_view method;
-  T params;
-  MSGPACK_DEFINE(type, msgid, method, params);
+  std::array<char, 48> data{};
+  size_t size = 0;
+
+  consteval NotificationPrefix(std::string_view _method) : method(_method) {
+    if (method.size() + 5 > data.size() || numArgs > 15) {
+      throw "NotificationPrefix: method name or argument count too long";
+    }
+    data[size++] = char(0x93); // fixarray 3
+    data[size++] = char(MessageType::Notification);
+    if (method.size() < 32) {
+      data[size++] = char(0xa0 | method.size()); // fixstr
+    } else {
+      data[size++] = char(0xd9); // str 8
+      data[size++] = char(method.size());
+    }
+    for (char c : method) {
+      data[size++] = c;
+    }
+    data[size++] = char(0x90 | numArgs); // fixarray params
+  }
 };
 
+
 struct Response {
   int32_t type;
   uint32_t msgid;
@@ -29,12 +54,12 @@ struct Response {
   MSGPACK_DEFINE(type, msgid, error, result);
 };
 
-template <typename T>
-struct NotificationOut {
-  int32_t type = MessageType::Notification;
+struct RequestIn {
+  int32_t type;
+  uint32_t msgid;
   std::string_view method;
-  T params;
-  MSGPACK_DEFINE(type, method, params);
+  msgpack::object params;
+  MSGPACK_DEFINE(type, msgid, method, params);
 };
 
 struct NotificationIn {
@@ -44,4 +69,31 @@ struct NotificationIn {
   MSGPACK_DEFINE(type, method, params);
 };
 
+// list of [method, args] pairs, packed lazily (nvim_call_atomic params)
+struct BatchCalls {
+  using Packer = msgpack::packer<msgpack::sbuffer>;
+  std::vector<std::function<void(Packer&)>> calls;
+};
+
 } // namespace rpc
+
+namespace msgpack {
+MSGPACK_API_VERSION_NAMESPACE(MSGPACK_DEFAULT_API_NS) {
+  namespace adaptor {
+    template <>
+    struct pack<rpc::BatchCalls> {
+      template <typename Stream>
+      packer<Stream>& operator()(packer<Stream>& o, const rpc::BatchCalls& v) const {
+        static_assert(
+          std::is_same_v<Stream, msgpack::sbuffer>, "BatchCalls only packs to sbuffer"
+        );
+        o.pack_array(v.calls.size());
+        for (const auto& call : v.calls) {
+          call(o);
+        }
+        return o;
+      }
+    };
+  } // namespace adaptor
+} // MSGPACK_API_VERSION_NAMESPACE(MSGPACK_DEFAULT_API_NS)
+} // namespace msgpack
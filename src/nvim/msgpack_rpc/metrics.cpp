@@ -0,0 +1,231 @@
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <format>
+
+namespace rpc {
+
+using namespace std::chrono;
+
+static size_t BucketIndex(uint64_t ns) {
+  constexpr int subBits = LatencyHistogram::subBits;
+  if (ns < LatencyHistogram::subCount) return ns;
+  int exp = std::bit_width(ns) - 1;
+  size_t sub = (ns >> (exp - subBits)) & (LatencyHistogram::subCount - 1);
+  return ((exp - subBits + 1) << subBits) + sub;
+}
+
+static uint64_t BucketUpperBound(size_t index) {
+  constexpr int subBits = LatencyHistogram::subBits;
+  if (index < LatencyHistogram::subCount) return index;
+  int exp = (index >> subBits) + subBits - 1;
+  uint64_t sub = index & (LatencyHistogram::subCount - 1);
+  uint64_t width = uint64_t(1) << (exp - subBits);
+  return ((LatencyHistogram::subCount + sub) << (exp - subBits)) + width - 1;
+}
+
+void LatencyHistogram::Record(nanoseconds latency) {
+  uint64_t ns = std::max<int64_t>(latency.count(), 0);
+  buckets[BucketIndex(ns)]++;
+  count++;
+  total += latency;
+  max = std::max(max, latency);
+}
+
+nanoseconds LatencyHistogram::Percentile(double p) const {
+  if (count == 0) return {};
+  uint64_t rank = std::max<uint64_t>(1, uint64_t(p * count + 0.5));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < buckets.size(); i++) {
+    seen += buckets[i];
+    if (seen >= rank) {
+      return std::min(nanoseconds(BucketUpperBound(i)), max);
+    }
+  }
+  return max;
+}
+
+nanoseconds LatencyHistogram::Mean() const {
+  if (count == 0) return {};
+  return total / count;
+}
+
+Metrics::MethodStats& Metrics::Method(std::string_view method) {
+  auto it = methods.find(method);
+  if (it == methods.end()) {
+    it = methods.emplace(std::string(method), MethodStats{}).first;
+  }
+  return it->second;
+}
+
+Metrics::MethodStats* Metrics::RecordRequest(std::string_view method) {
+  std::scoped_lock lock(mutex);
+  auto& stats = Method(method);
+  stats.requests++;
+  return &stats;
+}
+
+void Metrics::RecordBytesOut(MethodStats* stats, size_t bytes) {
+  std::scoped_lock lock(mutex);
+  stats->bytesOut += bytes;
+}
+
+void Metrics::RecordResponse(
+  MethodStats* stats, nanoseconds latency, size_t bytes, bool error
+) {
+  if (stats == nullptr) return;
+  std::scoped_lock lock(mutex);
+  stats->responses++;
+  stats->bytesIn += bytes;
+  if (error) stats->errors++;
+  stats->latency.Record(latency);
+}
+
+void Metrics::RecordNotificationOut(std::string_view method, size_t bytes) {
+  std::scoped_lock lock(mutex);
+  auto& stats = Method(method);
+  stats.notificationsOut++;
+  stats.bytesOut += bytes;
+}
+
+void Metrics::RecordNotificationIn(std::string_view method, size_t bytes) {
+  std::scoped_lock lock(mutex);
+  auto& stats = Method(method);
+  stats.notificationsIn++;
+  stats.bytesIn += bytes;
+}
+
+void Metrics::RecordRedrawIn(size_t bytes) {
+  redrawsIn.fetch_add(1, std::memory_order_relaxed);
+  redrawBytesIn.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+Metrics::MethodStats* Metrics::RecordRequestIn(std::string_view method, size_t bytes) {
+  std::scoped_lock lock(mutex);
+  auto& stats = Method(method);
+  stats.requestsIn++;
+  stats.bytesIn += bytes;
+  return &stats;
+}
+
+void Metrics::RecordReply(
+  MethodStats* stats, nanoseconds latency, size_t bytes, bool error
+) {
+  std::scoped_lock lock(mutex);
+  stats->bytesOut += bytes;
+  if (error) stats->errors++;
+  stats->latency.Record(latency);
+}
+
+void Metrics::RecordUiEvent(int index, std::string_view name, size_t count) {
+  if (index >= 0 && size_t(index) < uiEventNames.size()) {
+    uiEventCounts[index].fetch_add(count, std::memory_order_relaxed);
+    return;
+  }
+  std::scoped_lock lock(mutex);
+  auto it = uiEvents.find(name);
+  if (it == uiEvents.end()) {
+    it = uiEvents.emplace(std::string(name), 0).first;
+  }
+  it->second += count;
+}
+
+void Metrics::SetUiEventNames(std::span<const std::string_view> names) {
+  std::scoped_lock lock(mutex);
+  uiEventNames = names.first(std::min(names.size(), maxUiEvents));
+}
+
+nanoseconds Metrics::MarkStartup(std::string_view name) {
+  std::scoped_lock lock(mutex);
+  for (const auto& [mark, time] : startup) {
+    if (mark == name) return time;
+  }
+  auto time = steady_clock::now() - created;
+  startup.emplace_back(std::string(name), time);
+  return time;
+}
+
+static std::string FormatLatency(nanoseconds time) {
+  if (time < 1ms) return std::format("{}us", duration_cast<microseconds>(time).count());
+  return std::format("{:.1f}ms", duration<double, std::milli>(time).count());
+}
+
+void Metrics::FoldHotCounters() {
+  if (size_t redraws = redrawsIn.exchange(0, std::memory_order_relaxed)) {
+    auto& redraw = Method("redraw");
+    redraw.notificationsIn += redraws;
+    redraw.bytesIn += redrawBytesIn.exchange(0, std::memory_order_relaxed);
+  }
+  for (size_t i = 0; i < uiEventNames.size(); i++) {
+    if (size_t count = uiEventCounts[i].exchange(0, std::memory_order_relaxed)) {
+      auto it = uiEvents.find(uiEventNames[i]);
+      if (it == uiEvents.end()) {
+        it = uiEvents.emplace(std::string(uiEventNames[i]), 0).first;
+      }
+      it->second += count;
+    }
+  }
+}
+
+std::string Metrics::Dump() {
+  std::scoped_lock lock(mutex);
+  double seconds = duration<double>(steady_clock::now() - start).count();
+
+  std::string out = std::format("rpc metrics over {:.1f}s\n", seconds);
+  out += std::format(
+    "{:<28} {:>7} {:>5} {:>7} {:>7} {:>7} {:>7} {:>7} {:>10} {:>10} {:>10}\n",
+    "method", "calls", "errs", "mean", "p50", "p99", "max", "notifs", "out KB",
+    "in KB", "in KB/s"
+  );
+
+  FoldHotCounters();
+
+  size_t totalOut = 0;
+  size_t totalIn = 0;
+  for (const auto& [name, stats] : methods) {
+    const auto& h = stats.latency;
+    out += std::format(
+      "{:<28} {:>7} {:>5} {:>7} {:>7} {:>7} {:>7} {:>7} {:>10.1f} {:>10.1f} {:>10.1f}\n",
+      name, stats.requests + stats.requestsIn, stats.errors, FormatLatency(h.Mean()),
+      FormatLatency(h.Percentile(0.5)), FormatLatency(h.Percentile(0.99)),
+      FormatLatency(h.max), stats.notificationsIn + stats.notificationsOut,
+      stats.bytesOut / 1024.0, stats.bytesIn / 1024.0,
+      seconds > 0 ? stats.bytesIn / 1024.0 / seconds : 0.0
+    );
+    totalOut += stats.bytesOut;
+    totalIn += stats.bytesIn;
+  }
+  out += std::format(
+    "total out {:.1f} KB, in {:.1f} KB ({:.1f} KB/s)\n", totalOut / 1024.0,
+    totalIn / 1024.0, seconds > 0 ? totalIn / 1024.0 / seconds : 0.0
+  );
+
+  if (!startup.empty()) {
+    out += "startup";
+    for (const auto& [name, time] : startup) {
+      out += std::format(" {} {}", name, FormatLatency(time));
+    }
+    out += "\n";
+  }
+
+  if (!uiEvents.empty()) {
+    out += "ui events\n";
+    for (const auto& [name, count] : uiEvents) {
+      out += std::format("  {:<26} {:>9}\n", name, count);
+    }
+  }
+  return out;
+}
+
+void Metrics::Reset() {
+  std::scoped_lock lock(mutex);
+  FoldHotCounters(); // zeroes them
+  start = steady_clock::now();
+  for (auto& [name, stats] : methods) {
+    stats = {};
+  }
+  uiEvents.clear();
+}
+
+} // namespace rpc
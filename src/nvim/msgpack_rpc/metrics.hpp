@@ -0,0 +1,106 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace rpc {
+
+// Log linear latency histogram, 4 buckets per power of 2 nanoseconds
+// (at most 25% error on percentiles).
+struct LatencyHistogram {
+  static constexpr int subBits = 2;
+  static constexpr int subCount = 1 << subBits;
+  std::array<uint64_t, 64 * subCount> buckets{};
+  uint64_t count = 0;
+  std::chrono::nanoseconds total{};
+  std::chrono::nanoseconds max{};
+
+  void Record(std::chrono::nanoseconds latency);
+  // upper bound of the bucket containing the p-th percentile (0 to 1)
+  std::chrono::nanoseconds Percentile(double p) const;
+  std::chrono::nanoseconds Mean() const;
+};
+
+// Per method traffic counters of an rpc::Client.
+// Thread safe, requests are timed from AsyncCall to response arrival,
+// so latency covers the transport and the server, not the GUI.
+// For requests from nvim, latency is the time the GUI took to reply.
+struct Metrics {
+  struct MethodStats {
+    // outbound
+    size_t requests = 0;
+    size_t notificationsOut = 0;
+    size_t bytesOut = 0;
+    // inbound
+    size_t responses = 0;
+    size_t errors = 0;
+    size_t notificationsIn = 0;
+    size_t requestsIn = 0;
+    size_t bytesIn = 0;
+    LatencyHistogram latency;
+  };
+
+  // returns the stats to pass to the other Record functions,
+  // valid for the lifetime of Metrics
+  MethodStats* RecordRequest(std::string_view method);
+  void RecordBytesOut(MethodStats* stats, size_t bytes);
+  void RecordResponse(
+    MethodStats* stats, std::chrono::nanoseconds latency, size_t bytes, bool error
+  );
+  void RecordNotificationOut(std::string_view method, size_t bytes);
+  void RecordNotificationIn(std::string_view method, size_t bytes);
+  // lock free, the reader counts every redraw
+  void RecordRedrawIn(size_t bytes);
+  // requests from nvim
+  MethodStats* RecordRequestIn(std::string_view method, size_t bytes);
+  void RecordReply(
+    MethodStats* stats, std::chrono::nanoseconds latency, size_t bytes, bool error
+  );
+  // count is the number of event calls batched under this event name.
+  // index is the name's position in SetUiEventNames, those are counted lock free
+  // since every redraw event goes through here, -1 for names not in it
+  void RecordUiEvent(int index, std::string_view name, size_t count);
+  // names outlive Metrics, set before anything is recorded
+  void SetUiEventNames(std::span<const std::string_view> names);
+
+  // time since the client was created, only the first mark of each name is kept
+  // (connected, first redraw, first frame)
+  std::chrono::nanoseconds MarkStartup(std::string_view name);
+
+  // human readable table of everything since the last Reset()
+  // (Reset zeroes counters in place, so MethodStats pointers stay valid)
+  std::string Dump();
+  void Reset();
+
+private:
+  std::mutex mutex;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::map<std::string, MethodStats, std::less<>> methods;
+  std::map<std::string, size_t, std::less<>> uiEvents; // not in uiEventNames
+
+  // hot counters, moved into the maps by Dump() and Reset()
+  static constexpr size_t maxUiEvents = 64;
+  std::span<const std::string_view> uiEventNames;
+  std::array<std::atomic_size_t, maxUiEvents> uiEventCounts{};
+  std::atomic_size_t redrawsIn = 0;
+  std::atomic_size_t redrawBytesIn = 0;
+  // kept across Reset()
+  const std::chrono::steady_clock::time_point created =
+    std::chrono::steady_clock::now();
+  std::vector<std::pair<std::string, std::chrono::nanoseconds>> startup;
+
+  MethodStats& Method(std::string_view method); // hold mutex
+  // moves the hot counters into methods and uiEvents, hold mutex
+  void FoldHotCounters();
+};
+
+} // namespace rpc
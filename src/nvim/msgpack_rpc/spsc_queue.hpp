@@ -0,0 +1,196 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <algorithm>
+
+struct SpscQueueStats {
+  size_t depth;     // items currently queued
+  size_t maxDepth;  // high water mark
+  size_t pushed;    // total items pushed
+  size_t popped;    // total items popped
+  size_t fullWaits; // times the producer had to wait for space
+};
+
+// Bounded single producer, single consumer ring queue.
+// Push and Pop never lock, the mutex is only used when one side sleeps
+// (consumer waiting for items, producer waiting for space).
+template <typename T>
+struct SpscQueue {
+private:
+  static constexpr size_t cacheLine = 64;
+
+  size_t capacity; // power of 2
+  size_t mask;
+  std::unique_ptr<std::optional<T>[]> slots;
+
+  // consumer owned
+  alignas(cacheLine) std::atomic_size_t head = 0;
+  size_t cachedTail = 0;
+  std::atomic_size_t popped = 0;
+
+  // producer owned
+  alignas(cacheLine) std::atomic_size_t tail = 0;
+  size_t cachedHead = 0;
+  std::atomic_size_t maxDepth = 0;
+  std::atomic_size_t fullWaits = 0;
+
+  // sleeping/wakeup, only touched on the slow path
+  alignas(cacheLine) std::mutex waitMutex;
+  std::condition_variable waitCv;
+  std::atomic_bool consumerWaiting = false;
+  std::atomic_bool producerWaiting = false;
+  std::atomic_size_t wakeups = 0;
+  std::atomic_bool closed = false;
+
+  void NotifyIfWaiting(std::atomic_bool& waiting) {
+    // pairs with the fence in Wait, so either the waiter sees the new index
+    // or we see the waiting flag
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiting.load(std::memory_order_relaxed)) {
+      std::scoped_lock lock(waitMutex);
+      waitCv.notify_all();
+    }
+  }
+
+public:
+  SpscQueue(size_t minCapacity = 1024)
+      : capacity(std::bit_ceil(std::max<size_t>(minCapacity, 2))),
+        mask(capacity - 1),
+        slots(std::make_unique<std::optional<T>[]>(capacity)) {
+  }
+  SpscQueue(const SpscQueue&) = delete;
+  SpscQueue& operator=(const SpscQueue&) = delete;
+
+  // producer --------------------------------------------
+  // returns false if queue is full
+  bool TryPush(T&& item) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (t - cachedHead == capacity) {
+      cachedHead = head.load(std::memory_order_acquire);
+      if (t - cachedHead == capacity) return false;
+    }
+    slots[t & mask].emplace(std::move(item));
+    tail.store(t + 1, std::memory_order_release);
+
+    size_t depth = t + 1 - cachedHead;
+    if (depth > maxDepth.load(std::memory_order_relaxed)) {
+      maxDepth.store(depth, std::memory_order_relaxed);
+    }
+
+    NotifyIfWaiting(consumerWaiting);
+    return true;
+  }
+
+  // blocks while queue is full.
+  // returns false only once the queue is closed and still full,
+  // Wakeup() is meant for the consumer and doesn't stop the wait
+  bool Push(T&& item) {
+    if (TryPush(std::move(item))) return true;
+
+    fullWaits.fetch_add(1, std::memory_order_relaxed);
+    while (true) {
+      {
+        std::unique_lock lock(waitMutex);
+        producerWaiting = true;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        waitCv.wait(lock, [&] { return !Full() || closed; });
+        producerWaiting = false;
+        if (Full()) return false;
+      }
+      if (TryPush(std::move(item))) return true;
+    }
+  }
+
+  // consumer --------------------------------------------
+  // returns nullptr if queue is empty
+  T* Front() {
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h == cachedTail) {
+      cachedTail = tail.load(std::memory_order_acquire);
+      if (h == cachedTail) return nullptr;
+    }
+    return &*slots[h & mask];
+  }
+
+  void Pop() {
+    size_t h = head.load(std::memory_order_relaxed);
+    slots[h & mask].reset();
+    head.store(h + 1, std::memory_order_release);
+    popped.fetch_add(1, std::memory_order_relaxed);
+
+    NotifyIfWaiting(producerWaiting);
+  }
+
+  bool TryPop(T& out) {
+    T* item = Front();
+    if (item == nullptr) return false;
+    out = std::move(*item);
+    Pop();
+    return true;
+  }
+
+  // blocks until an item is available, Wakeup() is called, or timeout elapses.
+  // returns true if an item is available.
+  bool Wait(std::chrono::nanoseconds timeout) {
+    if (!Empty()) return true;
+
+    std::unique_lock lock(waitMutex);
+    size_t gen = wakeups;
+    consumerWaiting = true;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    waitCv.wait_for(lock, timeout, [&] { return !Empty() || wakeups != gen; });
+    consumerWaiting = false;
+    return !Empty();
+  }
+
+  // both sides ------------------------------------------
+  // wakes up the consumer sleeping in Wait()
+  void Wakeup() {
+    std::scoped_lock lock(waitMutex);
+    wakeups++;
+    waitCv.notify_all();
+  }
+
+  // Wakeup() that lasts, and the only way to stop Push() waiting for space
+  void Close() {
+    std::scoped_lock lock(waitMutex);
+    closed = true;
+    wakeups++;
+    waitCv.notify_all();
+  }
+
+  bool Empty() const {
+    return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+  }
+
+  bool Full() const {
+    return Size() == capacity;
+  }
+
+  size_t Size() const {
+    size_t h = head.load(std::memory_order_acquire);
+    size_t t = tail.load(std::memory_order_acquire);
+    return t - h;
+  }
+
+  size_t Capacity() const {
+    return capacity;
+  }
+
+  SpscQueueStats Stats() const {
+    return {
+      .depth = Size(),
+      .maxDepth = maxDepth.load(std::memory_order_relaxed),
+      .pushed = tail.load(std::memory_order_relaxed),
+      .popped = popped.load(std::memory_order_relaxed),
+      .fullWaits = fullWaits.load(std::memory_order_relaxed),
+    };
+  }
+};
@@ -0,0 +1,357 @@
+#include "transport.hpp"
+
+#include "asio/connect.hpp"
+#include "asio/ip/tcp.hpp"
+#include "asio/post.hpp"
+#include "asio/steady_timer.hpp"
+#include "asio/write.hpp"
+#include "capture.hpp"
+#include "utils/variant.hpp"
+
+#ifdef ASIO_HAS_LOCAL_SOCKETS
+#include "asio/local/stream_protocol.hpp"
+#endif
+#ifdef ASIO_HAS_POSIX_STREAM_DESCRIPTOR
+#include "asio/posix/stream_descriptor.hpp"
+#endif
+
+#include <cstring>
+#include <deque>
+#include <format>
+
+namespace rpc {
+
+std::string ToString(const Endpoint& endpoint) {
+  return std::visit(overloaded{
+    [](const TcpEndpoint& e) { return std::format("{}:{}", e.host, e.port); },
+    [](const LocalEndpoint& e) { return e.path; },
+    [](const PipeEndpoint& e) { return std::format("pipe({}, {})", e.readFd, e.writeFd); },
+    [](const ReplayEndpoint& e) { return std::format("replay({})", e.path); },
+  }, endpoint);
+}
+
+// single full duplex stream (tcp and unix sockets)
+template <typename Stream>
+struct StreamTransport : Transport {
+  Stream stream;
+
+  StreamTransport(Stream&& _stream) : stream(std::move(_stream)) {
+  }
+
+  void AsyncReadSome(asio::mutable_buffer buffer, IoHandler&& handler) override {
+    stream.async_read_some(buffer, std::move(handler));
+  }
+
+  void AsyncWrite(
+    std::span<const asio::const_buffer> buffers, IoHandler&& handler
+  ) override {
+    asio::async_write(stream, buffers, std::move(handler));
+  }
+
+  bool IsOpen() override {
+    return stream.is_open();
+  }
+
+  void Close() override {
+    asio::error_code ec;
+    stream.close(ec);
+  }
+};
+
+#ifdef ASIO_HAS_POSIX_STREAM_DESCRIPTOR
+// separate read and write ends (child process stdio)
+struct PipeTransport : Transport {
+  asio::posix::stream_descriptor in;
+  asio::posix::stream_descriptor out;
+
+  PipeTransport(asio::io_context& context, int readFd, int writeFd)
+      : in(context, readFd), out(context, writeFd) {
+  }
+
+  void AsyncReadSome(asio::mutable_buffer buffer, IoHandler&& handler) override {
+    in.async_read_some(buffer, std::move(handler));
+  }
+
+  void AsyncWrite(
+    std::span<const asio::const_buffer> buffers, IoHandler&& handler
+  ) override {
+    asio::async_write(out, buffers, std::move(handler));
+  }
+
+  bool IsOpen() override {
+    return in.is_open() && out.is_open();
+  }
+
+  void Close() override {
+    asio::error_code ec;
+    in.close(ec);
+    out.close(ec);
+  }
+};
+#endif
+
+// plays back a capture file
+struct ReplayTransport : Transport {
+  asio::io_context& context;
+  asio::steady_timer timer;
+  CaptureReader reader;
+  bool realtime;
+  bool open = true;
+  std::chrono::steady_clock::time_point start;
+
+  CaptureChunk chunk;
+  size_t chunkOffset = 0;
+
+  ReplayTransport(asio::io_context& _context, bool _realtime)
+      : context(_context), timer(_context), realtime(_realtime),
+        start(std::chrono::steady_clock::now()) {
+  }
+
+  void AsyncReadSome(asio::mutable_buffer buffer, IoHandler&& handler) override {
+    if (!open) {
+      asio::post(context, [handler = std::move(handler)] {
+        handler(asio::error::operation_aborted, 0);
+      });
+      return;
+    }
+
+    if (chunkOffset == chunk.data.size()) {
+      chunkOffset = 0;
+      if (!reader.Next(chunk)) {
+        chunk.data.clear();
+        asio::post(context, [handler = std::move(handler)] {
+          handler(asio::error::eof, 0);
+        });
+        return;
+      }
+    }
+
+    size_t length = std::min(buffer.size(), chunk.data.size() - chunkOffset);
+    std::memcpy(buffer.data(), chunk.data.data() + chunkOffset, length);
+    chunkOffset += length;
+
+    if (realtime) {
+      timer.expires_at(start + chunk.time);
+      timer.async_wait([handler = std::move(handler), length](asio::error_code ec) {
+        handler(ec, ec ? 0 : length);
+      });
+    } else {
+      asio::post(context, [handler = std::move(handler), length] {
+        handler({}, length);
+      });
+    }
+  }
+
+  void AsyncWrite(
+    std::span<const asio::const_buffer> buffers, IoHandler&& handler
+  ) override {
+    asio::post(context, [handler = std::move(handler), size = asio::buffer_size(buffers)] {
+      handler({}, size);
+    });
+  }
+
+  bool IsOpen() override {
+    return open;
+  }
+
+  void Close() override {
+    open = false;
+    timer.cancel();
+  }
+};
+
+// reads ahead from inner and hands data out once it's old enough,
+// writes wait before going out (the client only has one write in flight)
+struct DelayTransport : Transport {
+  using Clock = std::chrono::steady_clock;
+
+  asio::io_context& context;
+  std::unique_ptr<Transport> inner;
+  std::chrono::nanoseconds delay;
+  asio::steady_timer readTimer;
+  asio::steady_timer writeTimer;
+
+  struct Chunk {
+    Clock::time_point due;
+    std::vector<char> data;
+  };
+  std::vector<char> readBuffer = std::vector<char>(64 << 10);
+  std::deque<Chunk> chunks;
+  size_t chunkOffset = 0;
+  asio::error_code readError;
+  bool waiting = false;
+
+  asio::mutable_buffer pendingBuffer;
+  IoHandler pendingHandler;
+
+  DelayTransport(
+    asio::io_context& _context, std::unique_ptr<Transport>&& _inner,
+    std::chrono::nanoseconds _delay
+  )
+      : context(_context), inner(std::move(_inner)), delay(_delay), readTimer(_context),
+        writeTimer(_context) {
+    ReadAhead();
+  }
+
+  void ReadAhead() {
+    inner->AsyncReadSome(
+      asio::buffer(readBuffer), [this](const asio::error_code& ec, size_t length) {
+        if (ec) {
+          readError = ec;
+        } else {
+          chunks.push_back(
+            {Clock::now() + delay, {readBuffer.begin(), readBuffer.begin() + length}}
+          );
+          ReadAhead();
+        }
+        Deliver();
+      }
+    );
+  }
+
+  void Deliver() {
+    if (!pendingHandler || waiting) return;
+
+    if (chunks.empty()) {
+      if (!readError) return;
+      asio::post(context, [handler = std::move(pendingHandler), ec = readError] {
+        handler(ec, 0);
+      });
+      pendingHandler = nullptr;
+      return;
+    }
+
+    auto& chunk = chunks.front();
+    if (chunk.due > Clock::now()) {
+      waiting = true;
+      readTimer.expires_at(chunk.due);
+      readTimer.async_wait([this](asio::error_code ec) {
+        waiting = false;
+        if (ec) return;
+        Deliver();
+      });
+      return;
+    }
+
+    size_t length = std::min(pendingBuffer.size(), chunk.data.size() - chunkOffset);
+    std::memcpy(pendingBuffer.data(), chunk.data.data() + chunkOffset, length);
+    chunkOffset += length;
+    if (chunkOffset == chunk.data.size()) {
+      chunks.pop_front();
+      chunkOffset = 0;
+    }
+    asio::post(context, [handler = std::move(pendingHandler), length] {
+      handler({}, length);
+    });
+    pendingHandler = nullptr;
+  }
+
+  void AsyncReadSome(asio::mutable_buffer buffer, IoHandler&& handler) override {
+    pendingBuffer = buffer;
+    pendingHandler = std::move(handler);
+    Deliver();
+  }
+
+  void AsyncWrite(
+    std::span<const asio::const_buffer> buffers, IoHandler&& handler
+  ) override {
+    writeTimer.expires_after(delay);
+    writeTimer.async_wait(
+      [this, buffers, handler = std::move(handler)](asio::error_code ec) mutable {
+        if (ec) {
+          handler(ec, 0);
+          return;
+        }
+        inner->AsyncWrite(buffers, std::move(handler));
+      }
+    );
+  }
+
+  bool IsOpen() override {
+    return inner->IsOpen();
+  }
+
+  void Close() override {
+    inner->Close();
+    readTimer.cancel();
+    writeTimer.cancel();
+  }
+};
+
+std::unique_ptr<Transport> MakeDelayTransport(
+  asio::io_context& context, std::unique_ptr<Transport>&& inner,
+  std::chrono::nanoseconds delay
+) {
+  return std::make_unique<DelayTransport>(context, std::move(inner), delay);
+}
+
+static std::unique_ptr<Transport>
+ConnectReplay(asio::io_context& context, const ReplayEndpoint& e, asio::error_code& ec) {
+  auto transport = std::make_unique<ReplayTransport>(context, e.realtime);
+  if (!transport->reader.Open(e.path)) {
+    ec = asio::error::not_found;
+    return nullptr;
+  }
+  return transport;
+}
+
+static std::unique_ptr<Transport>
+ConnectTcp(asio::io_context& context, const TcpEndpoint& e, asio::error_code& ec) {
+  asio::ip::tcp::resolver resolver(context);
+  auto endpoints = resolver.resolve(e.host, std::to_string(e.port), ec);
+  if (ec) return nullptr;
+
+  asio::ip::tcp::socket socket(context);
+  asio::connect(socket, endpoints, ec);
+  if (ec) return nullptr;
+
+  // input is lots of tiny messages, don't let nagle hold them back
+  asio::error_code optionEc;
+  socket.set_option(asio::ip::tcp::no_delay(true), optionEc);
+
+  return std::make_unique<StreamTransport<asio::ip::tcp::socket>>(std::move(socket));
+}
+
+static std::unique_ptr<Transport>
+ConnectLocal(asio::io_context& context, const LocalEndpoint& e, asio::error_code& ec) {
+#ifdef ASIO_HAS_LOCAL_SOCKETS
+  using asio::local::stream_protocol;
+  stream_protocol::socket socket(context);
+  socket.connect(stream_protocol::endpoint(e.path), ec);
+  if (ec) return nullptr;
+
+  return std::make_unique<StreamTransport<stream_protocol::socket>>(std::move(socket));
+#else
+  (void)context, (void)e;
+  ec = asio::error::operation_not_supported;
+  return nullptr;
+#endif
+}
+
+static std::unique_ptr<Transport>
+ConnectPipe(asio::io_context& context, const PipeEndpoint& e, asio::error_code& ec) {
+#ifdef ASIO_HAS_POSIX_STREAM_DESCRIPTOR
+  if (e.readFd < 0 || e.writeFd < 0) {
+    ec = asio::error::bad_descriptor;
+    return nullptr;
+  }
+  return std::make_unique<PipeTransport>(context, e.readFd, e.writeFd);
+#else
+  (void)context, (void)e;
+  ec = asio::error::operation_not_supported;
+  return nullptr;
+#endif
+}
+
+std::unique_ptr<Transport>
+MakeTransport(asio::io_context& context, const Endpoint& endpoint, asio::error_code& ec) {
+  ec.clear();
+  return std::visit(overloaded{
+    [&](const TcpEndpoint& e) { return ConnectTcp(context, e, ec); },
+    [&](const LocalEndpoint& e) { return ConnectLocal(context, e, ec); },
+    [&](const PipeEndpoint& e) { return ConnectPipe(context, e, ec); },
+    [&](const ReplayEndpoint& e) { return ConnectReplay(context, e, ec); },
+  }, endpoint);
+}
+
+} // namespace rpc
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "asio/buffer.hpp"
+#include "asio/error_code.hpp"
+#include "asio/io_context.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace rpc {
+
+// nvim --listen host:port
+struct TcpEndpoint {
+  std::string host;
+  uint16_t port;
+};
+
+// nvim --listen /path/to/socket
+struct LocalEndpoint {
+  std::string path;
+};
+
+// nvim --embed, the child's stdout and stdin.
+// fds are owned by the transport once connected, so each one is single use.
+struct PipeEndpoint {
+  int readFd;
+  int writeFd;
+};
+
+// capture file recorded with Client::StartCapture, see capture.hpp.
+// writes are discarded, reads are fed from the file at the original pace
+// or as fast as possible.
+struct ReplayEndpoint {
+  std::string path;
+  bool realtime = true;
+};
+
+using Endpoint = std::variant<TcpEndpoint, LocalEndpoint, PipeEndpoint, ReplayEndpoint>;
+
+std::string ToString(const Endpoint& endpoint);
+
+using IoHandler = std::function<void(const asio::error_code& ec, size_t length)>;
+
+// Byte stream the msgpack-rpc client runs over.
+// All operations must be called from the io_context thread.
+struct Transport {
+  virtual ~Transport() = default;
+
+  virtual void AsyncReadSome(asio::mutable_buffer buffer, IoHandler&& handler) = 0;
+  // buffers (and the span itself) must stay valid until handler is called,
+  // a span so queuing the write doesn't copy the buffer list
+  virtual void AsyncWrite(
+    std::span<const asio::const_buffer> buffers, IoHandler&& handler
+  ) = 0;
+
+  virtual bool IsOpen() = 0;
+  virtual void Close() = 0;
+};
+
+// returns nullptr and sets ec on failure
+std::unique_ptr<Transport>
+MakeTransport(asio::io_context& context, const Endpoint& endpoint, asio::error_code& ec);
+
+// wraps inner so everything read and written arrives delay late,
+// for trying out slow connections locally
+std::unique_ptr<Transport> MakeDelayTransport(
+  asio::io_context& context, std::unique_ptr<Transport>&& inner,
+  std::chrono::nanoseconds delay
+);
+
+} // namespace rpc
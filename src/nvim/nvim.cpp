@@ -1,24 +1,63 @@
 #include "nvim.hpp"
 #include "utils/logger.hpp"
+#include "utils/worker_pool.hpp"
+#include <algorithm>
 #include <thread>
+#include <format>
 
-Nvim::Nvim(std::string_view host, uint16_t port) {
-  using namespace std::chrono_literals;
-  auto timeout = 500ms;
-  auto elapsed = 0ms;
-  auto delay = 50ms;
-  while (elapsed < timeout) {
-    if (client.Connect(host, port)) break;
-    // if (client.Connect("data.cs.purdue.edu", port)) break;
-    std::this_thread::sleep_for(delay);
-    elapsed += delay;
+// decodes big grid_line events for every session, a session decoding while
+// another has the pool just decodes alone
+static WorkerPool& DecodePool() {
+  static WorkerPool pool(std::clamp(std::thread::hardware_concurrency() / 2, 1u, 4u));
+  return pool;
+}
+
+Nvim::Nvim(std::string_view host, uint16_t port)
+    : Nvim(rpc::TcpEndpoint{std::string(host), port}) {
+}
+
+Nvim::Nvim(const rpc::Endpoint& endpoint, std::chrono::nanoseconds injectedDelay) {
+  client.injectedDelay = injectedDelay;
+  bool isSocket = std::holds_alternative<rpc::TcpEndpoint>(endpoint) ||
+                  std::holds_alternative<rpc::LocalEndpoint>(endpoint);
+  if (!isSocket) {
+    // pipes are connected as soon as the child is spawned
+    client.Connect(endpoint);
+  } else {
+    // freshly spawned server may not be listening yet, failed connects are
+    // cheap (refused straight away) so retry fast and back off from there
+    using namespace std::chrono;
+    using namespace std::chrono_literals;
+    auto timeout = 2s;
+    auto maxDelay = 20ms;
+    nanoseconds delay = 250us;
+    auto start = steady_clock::now();
+    int attempts = 0;
+    while (true) {
+      attempts++;
+      if (client.Connect(endpoint)) break;
+      if (steady_clock::now() - start >= timeout) break;
+      std::this_thread::sleep_for(delay);
+      delay = std::min<nanoseconds>(delay * 2, maxDelay);
+    }
+    if (attempts > 1 && client.IsConnected()) {
+      LOG_INFO(
+        "Connected after {} attempts in {}us", attempts,
+        duration_cast<microseconds>(steady_clock::now() - start).count()
+      );
+    }
   }
 
+  client.RegisterHandler("rpc_stats", [this](const msgpack::object&, rpc::Reply& reply) {
+    reply.Result(client.DumpMetrics() + coalesceStats.Dump() + "\n");
+  });
+
   if (client.IsConnected()) {
     // std::cout << "Connected to nvim" << std::endl;
+    client.metrics.MarkStartup("connected");
     LOG_INFO("Connected to nvim");
   } else {
-    throw std::runtime_error("Failed to connect to port " + std::to_string(port));
+    throw std::runtime_error("Failed to connect to " + rpc::ToString(endpoint));
   }
 
   SetClientInfo(
@@ -31,13 +70,32 @@ Nvim::Nvim(std::string_view host, uint16_t port) {
     "ui", {}, {}
   );
 
+  client.metrics.SetUiEventNames(UiEventNames());
+  uiEvents.coalesceStats = &coalesceStats;
+  uiEvents.decodePool = &DecodePool();
+  parseThr = std::thread([this] {
+    using namespace std::chrono_literals;
+    // debug LOG calls in the event parsers stay quiet
+    LOG_DISABLE();
+    while (client.IsConnected()) {
+      client.WaitNotification(100ms);
+      ParseEvents(client, uiEvents, sessionCmds, redrawTimes);
+    }
+    // notifications queued before the disconnect
+    ParseEvents(client, uiEvents, sessionCmds, redrawTimes);
+  });
+
   // auto result = client.Call("nvim_get_api_info");
   // channelId = result->via.array.ptr[0].convert();
   // LOG_INFO("nvim_get_api_info: {}", channelId);
 }
 
 Nvim::~Nvim() {
+  // rpc_stats reads coalesceStats, which goes away before client does
+  client.StopHandlers();
   client.Disconnect();
+  uiEvents.Close();
+  if (parseThr.joinable()) parseThr.join();
 }
 
 bool Nvim::IsConnected() {
@@ -66,12 +124,15 @@ void Nvim::UiDetach() {
   client.Send("nvim_ui_detach");
 }
 
+// hot calls, headers are packed at compile time
 void Nvim::UiTryResize(int width, int height) {
-  client.Send("nvim_ui_try_resize", width, height);
+  static constexpr rpc::NotificationPrefix<2> prefix("nvim_ui_try_resize");
+  client.Send(prefix, width, height);
 }
 
 void Nvim::Input(std::string_view input) {
-  client.Send("nvim_input", input);
+  static constexpr rpc::NotificationPrefix<1> prefix("nvim_input");
+  client.Send(prefix, input);
 }
 
 void Nvim::InputMouse(
@@ -82,16 +143,13 @@ void Nvim::InputMouse(
   int row,
   int col
 ) {
-  client.Send("nvim_input_mouse", button, action, modifier, grid, row, col);
+  static constexpr rpc::NotificationPrefix<6> prefix("nvim_input_mouse");
+  client.Send(prefix, button, action, modifier, grid, row, col);
 }
 
-void Nvim::ListUis() {
-  auto response = client.AsyncCall("nvim_list_uis");
-
-  std::thread([response = std::move(response)]() mutable {
-    auto result = response.get();
-    LOG_INFO("nvim_list_uis: {}", ToString(result.get()));
-  }).detach();
+rpc::Task Nvim::ListUis() {
+  auto result = co_await Call("nvim_list_uis");
+  LOG_INFO("nvim_list_uis: {}", ToString(result.get()));
 }
 
 msgpack::object_handle Nvim::GetOptionValue(std::string_view name, MapRef opts) {
@@ -105,3 +163,25 @@ msgpack::object_handle Nvim::GetVar(std::string_view name) {
 msgpack::object_handle Nvim::ExecLua(std::string_view code, VectorRef args) {
   return client.Call("nvim_exec_lua", code, args);
 }
+
+Nvim::BatchResults Nvim::ExecBatch(const Batch& batch) {
+  BatchResults batchResults;
+  if (batch.calls.calls.empty()) return batchResults;
+
+  // returns [results, error], error is [index, type, message] or nil
+  auto handle = client.Call("nvim_call_atomic", batch.calls);
+  const auto& response = handle->via.array;
+  const auto& results = response.ptr[0].via.array;
+  batchResults.results = {results.ptr, results.size};
+
+  const auto& error = response.ptr[1];
+  if (!error.is_nil()) {
+    const auto& errArr = error.via.array;
+    batchResults.error = std::format(
+      "call {} failed: {}", errArr.ptr[0].as<int>(), errArr.ptr[2].as<std::string>()
+    );
+  }
+
+  batchResults.handle = std::move(handle);
+  return batchResults;
+}
@@ -1,16 +1,28 @@
 #pragma once
 
 #include "msgpack_rpc/client.hpp"
+#include "nvim/events/coalesce.hpp"
 #include "nvim/events/parse.hpp"
+#include <chrono>
+#include <optional>
+#include <span>
 #include <string_view>
+#include <thread>
 
 // Nvim client that wraps the rpc client.
 struct Nvim {
   rpc::Client client;
+  // notifications are decoded on parseThr, so a redraw burst doesn't hold up
+  // the render thread. flushed redraws come out of uiEvents
   UiEvents uiEvents;
+  SpscQueue<SessionCmd> sessionCmds{64};
+  RedrawTimes redrawTimes;
+  CoalesceStats coalesceStats;
   // int channelId;
 
   Nvim() = default;
+  // injectedDelay is added each way, to test slow connections
+  Nvim(const rpc::Endpoint& endpoint, std::chrono::nanoseconds injectedDelay = {});
   Nvim(std::string_view host, uint16_t port);
   Nvim(const Nvim&) = delete;
   Nvim& operator=(const Nvim&) = delete;
@@ -18,6 +30,11 @@ struct Nvim {
 
   bool IsConnected();
 
+  // raw request, use Then() or co_await (inside an rpc::Task) for the result
+  rpc::CallHandle Call(std::string_view method, auto... args) {
+    return client.AsyncCall(method, args...);
+  }
+
   using Variant = msgpack::type::variant;
   using VariantRef = msgpack::type::variant_ref;
   using MapRef = const std::map<std::string_view, VariantRef>&;
@@ -42,8 +59,54 @@ struct Nvim {
     int row,
     int col
   );
-  void ListUis();
+  rpc::Task ListUis();
   msgpack::object_handle GetOptionValue(std::string_view name, MapRef opts);
   msgpack::object_handle GetVar(std::string_view name);
   msgpack::object_handle ExecLua(std::string_view code, VectorRef args);
+
+  // Builds a list of calls that are sent as a single nvim_call_atomic request.
+  // Args are copied, but anything they point to must outlive ExecBatch().
+  struct Batch {
+    template <typename T>
+    struct Ref {
+      size_t index;
+    };
+    rpc::BatchCalls calls;
+
+    template <typename T = msgpack::object>
+    Ref<T> Add(std::string_view method, auto... args) {
+      calls.calls.emplace_back(
+        [method, params = std::tuple(args...)](rpc::BatchCalls::Packer& pk) {
+          pk.pack_array(2);
+          pk.pack(method);
+          pk.pack(params);
+        }
+      );
+      return {calls.calls.size() - 1};
+    }
+  };
+
+  struct BatchResults {
+    msgpack::object_handle handle;
+    std::span<const msgpack::object> results;
+    // nvim stops at the first failed call, results after it are missing
+    std::optional<std::string> error;
+
+    // nullopt if the call failed or the result isn't convertible to T
+    template <typename T>
+    std::optional<T> Get(Batch::Ref<T> ref) const {
+      if (ref.index >= results.size()) return std::nullopt;
+      try {
+        return results[ref.index].template as<T>();
+      } catch (const std::exception&) {
+        return std::nullopt;
+      }
+    }
+  };
+
+  // one round trip for the whole batch
+  BatchResults ExecBatch(const Batch& batch);
+
+private:
+  std::thread parseThr;
 };
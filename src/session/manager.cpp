@@ -2,24 +2,49 @@
 
 #include "boost/asio/io_service.hpp"
 #include "boost/asio/ip/tcp.hpp"
+#include "boost/process/io.hpp"
+#include "boost/process/pipe.hpp"
 #include "utils/logger.hpp"
 #include <fstream>
 #include <sstream>
 #include <filesystem>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 namespace bp = boost::process;
 namespace fs = std::filesystem;
+using namespace std::chrono;
 
-SessionManager::SessionManager(SpawnMode _mode) : mode(_mode) {
+SessionManager::SessionManager(SpawnMode _mode, size_t _poolSize, seconds _poolTtl)
+    : mode(_mode), poolSize(_poolSize), poolTtl(_poolTtl) {
   if (mode == SpawnMode::Child) {
 
   } else if (mode == SpawnMode::Detached) {
     std::string filename = ROOT_DIR "nvim-sessions.txt";
     LoadSessions(filename);
   }
+
+  if (poolSize > 0) {
+    poolThread = std::thread([this] { RunPool(); });
+  }
 }
 
 SessionManager::~SessionManager() {
+  if (poolThread.joinable()) {
+    {
+      std::scoped_lock lock(poolMutex);
+      poolExit = true;
+    }
+    poolCv.notify_all();
+    poolThread.join();
+  }
+  for (auto& process : pool) {
+    Kill(process);
+  }
+
   if (mode == SpawnMode::Child) {
     for (auto& process : processes) {
       process.terminate();
@@ -38,7 +63,7 @@ void SessionManager::LoadSessions(std::string_view filename) {
     std::string session_name;
     uint16_t port;
     if (iss >> session_name >> port) {
-      sessions[session_name] = port;
+      sessions[session_name] = rpc::TcpEndpoint{"localhost", port};
     }
   }
 }
@@ -46,7 +71,10 @@ void SessionManager::LoadSessions(std::string_view filename) {
 void SessionManager::SaveSessions(std::string_view filename) {
   std::ofstream file(filename);
   for (auto& [key, value] : sessions) {
-    file << key << " " << value << "\n";
+    // only tcp sessions outlive the gui
+    if (auto* tcp = std::get_if<rpc::TcpEndpoint>(&value)) {
+      file << key << " " << tcp->port << "\n";
+    }
   }
 }
 
@@ -64,12 +92,38 @@ static uint16_t FindFreePort() {
   return acceptor.local_endpoint().port();
 }
 
-void SessionManager::SpawnNvimProcess(uint16_t port) {
+static std::string NvimCmd(std::string_view args) {
   std::string luaInitPath = ROOT_DIR "/lua/init.lua";
-  std::string cmd = "nvim --listen localhost:" + std::to_string(port) +
-                    " --headless " +
-                    "--cmd \"luafile " + luaInitPath + "\"";
-  bp::child child(cmd);
+  return std::format("nvim {} --headless --cmd \"luafile {}\"", args, luaInitPath);
+}
+
+static bp::child SpawnListen(uint16_t port) {
+  return bp::child(NvimCmd("--listen localhost:" + std::to_string(port)));
+}
+
+#ifndef _WIN32
+static bp::child SpawnEmbed(rpc::PipeEndpoint& endpoint) {
+  bp::pipe toNvim;
+  bp::pipe fromNvim;
+  bp::child child(NvimCmd("--embed"), bp::std_in < toNvim, bp::std_out > fromNvim);
+
+  // keep our ends (close on exec so later children don't inherit them),
+  // the pipes close everything else when they go out of scope
+  endpoint = {
+    .readFd = fcntl(fromNvim.native_source(), F_DUPFD_CLOEXEC, 0),
+    .writeFd = fcntl(toNvim.native_sink(), F_DUPFD_CLOEXEC, 0),
+  };
+  if (endpoint.readFd < 0 || endpoint.writeFd < 0) {
+    std::error_code ec;
+    child.terminate(ec);
+    throw std::runtime_error("Failed to set up nvim --embed pipes");
+  }
+  return child;
+}
+#endif
+
+void SessionManager::SpawnNvimProcess(uint16_t port) {
+  bp::child child = SpawnListen(port);
   if (mode == SpawnMode::Child) {
     processes.push_back(std::move(child));
   } else if (mode == SpawnMode::Detached) {
@@ -77,16 +131,158 @@ void SessionManager::SpawnNvimProcess(uint16_t port) {
   }
 }
 
-uint16_t SessionManager::GetOrCreateSession(const std::string& session_name) {
+// --headless so init files are sourced before ui attach, same as --listen
+rpc::PipeEndpoint SessionManager::SpawnNvimEmbed() {
+#ifndef _WIN32
+  rpc::PipeEndpoint endpoint;
+  processes.push_back(SpawnEmbed(endpoint));
+  return endpoint;
+#else
+  throw std::runtime_error("nvim --embed not supported on this platform");
+#endif
+}
+
+rpc::Endpoint SessionManager::GetOrCreateSession(const std::string& session_name) {
+  std::scoped_lock lock(sessionsMutex);
   auto [it, inserted] = sessions.try_emplace(session_name);
   if (inserted) {
-    it->second = FindFreePort();
-    SpawnNvimProcess(it->second);
-    LOG_INFO("Created session {} on port {}", session_name, it->second);
+#ifndef _WIN32
+    constexpr bool canEmbed = true;
+#else
+    constexpr bool canEmbed = false;
+#endif
+    if (auto endpoint = ClaimWarm()) {
+      it->second = std::move(*endpoint);
+    } else if (mode == SpawnMode::Child && canEmbed) {
+      it->second = SpawnNvimEmbed();
+    } else {
+      uint16_t port = FindFreePort();
+      SpawnNvimProcess(port);
+      it->second = rpc::TcpEndpoint{"localhost", port};
+    }
+    LOG_INFO("Created session {} on {}", session_name, rpc::ToString(it->second));
   }
   return it->second;
 }
 
 void SessionManager::RemoveSession(const std::string& session_name) {
+  std::scoped_lock lock(sessionsMutex);
   sessions.erase(session_name);
 }
+
+// warm pool ---------------------------------------------------
+SessionManager::WarmProcess SessionManager::SpawnWarm() {
+  WarmProcess process{.spawned = steady_clock::now()};
+#ifndef _WIN32
+  if (mode == SpawnMode::Child) {
+    rpc::PipeEndpoint endpoint;
+    process.child = SpawnEmbed(endpoint);
+    process.endpoint = endpoint;
+    return process;
+  }
+#endif
+  // detached sessions are kept as children until claimed,
+  // so unused ones don't outlive the gui
+  uint16_t port = FindFreePort();
+  process.child = SpawnListen(port);
+  process.endpoint = rpc::TcpEndpoint{"localhost", port};
+  return process;
+}
+
+void SessionManager::Kill(WarmProcess& process) {
+  std::error_code ec;
+  if (process.child.valid()) process.child.terminate(ec);
+#ifndef _WIN32
+  if (auto* pipe = std::get_if<rpc::PipeEndpoint>(&process.endpoint)) {
+    close(pipe->readFd);
+    close(pipe->writeFd);
+  }
+#endif
+}
+
+std::optional<rpc::Endpoint> SessionManager::ClaimWarm() {
+  if (poolSize == 0) return std::nullopt;
+
+  std::unique_lock lock(poolMutex);
+  while (!pool.empty()) {
+    auto process = std::move(pool.front());
+    pool.pop_front();
+    poolCv.notify_all();
+
+    std::error_code ec;
+    if (!process.child.running(ec)) {
+      LOG_WARN("SessionManager: warm nvim exited early");
+      Kill(process);
+      continue;
+    }
+    lock.unlock();
+
+    if (mode == SpawnMode::Child) {
+      processes.push_back(std::move(process.child));
+    } else {
+      process.child.detach();
+    }
+    LOG_INFO(
+      "SessionManager: claimed nvim warmed for {}ms",
+      duration_cast<milliseconds>(steady_clock::now() - process.spawned).count()
+    );
+    return process.endpoint;
+  }
+  return std::nullopt;
+}
+
+void SessionManager::RunPool() {
+  std::unique_lock lock(poolMutex);
+  poolCv.wait_for(lock, poolStartDelay, [&] { return poolExit; });
+
+  while (!poolExit) {
+    auto now = steady_clock::now();
+    auto expired = [&](WarmProcess& process) {
+      std::error_code ec;
+      bool stale = poolTtl.count() > 0 && now - process.spawned >= poolTtl;
+      return stale || !process.child.running(ec);
+    };
+    std::vector<WarmProcess> stale;
+    for (auto it = pool.begin(); it != pool.end();) {
+      if (expired(*it)) {
+        stale.push_back(std::move(*it));
+        it = pool.erase(it);
+      } else {
+        it++;
+      }
+    }
+    bool refill = pool.size() < poolSize;
+    lock.unlock();
+
+    for (auto& process : stale) {
+      Kill(process);
+    }
+    std::optional<WarmProcess> spawned;
+    if (refill) {
+      try {
+        spawned = SpawnWarm();
+      } catch (const std::exception& e) {
+        LOG_WARN("SessionManager: failed to spawn warm nvim: {}", e.what());
+      }
+    }
+
+    lock.lock();
+    if (spawned) {
+      pool.push_back(std::move(*spawned));
+      continue;
+    }
+    if (refill) {
+      // spawning failed, try again later
+      poolCv.wait_for(lock, 5s, [&] { return poolExit; });
+      continue;
+    }
+
+    // sleep until a process is claimed or the oldest one expires
+    auto needsRefill = [&] { return poolExit || pool.size() < poolSize; };
+    if (poolTtl.count() > 0) {
+      poolCv.wait_until(lock, pool.front().spawned + poolTtl, needsRefill);
+    } else {
+      poolCv.wait(lock, needsRefill);
+    }
+  }
+}
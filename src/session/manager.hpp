@@ -1,30 +1,76 @@
 #pragma once
 
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <thread>
 #include <unordered_map>
 #include <string_view>
 #include <string>
+#include <vector>
 #include "boost/process/child.hpp"
+#include "nvim/msgpack_rpc/transport.hpp"
 
 enum class SpawnMode {
-  Child,
-  Detached,
+  Child,    // nvim --embed over stdio pipes, killed on exit
+  Detached, // nvim --listen over tcp, outlives the gui
 };
 
 struct SessionManager {
   SpawnMode mode;
-  std::unordered_map<std::string, uint16_t> sessions;
+  // sessions are created off the render thread and removed on it,
+  // guards sessions and processes
+  std::mutex sessionsMutex;
+  // embedded (pipe) sessions can only be connected to once
+  std::unordered_map<std::string, rpc::Endpoint> sessions;
   // used if SpawnMode is Child
   std::vector<boost::process::child> processes;
 
+  // nvim processes started ahead of time and left to finish loading init files,
+  // new sessions take one instead of waiting on startup.
+  // refilled in the background, restarted after poolTtl so they don't go stale
+  size_t poolSize = 0;
+  std::chrono::seconds poolTtl{};
+
   SessionManager() = default;
-  SessionManager(SpawnMode mode);
+  SessionManager(
+    SpawnMode mode,
+    size_t poolSize = 1,
+    std::chrono::seconds poolTtl = std::chrono::minutes(10)
+  );
+  SessionManager(const SessionManager&) = delete;
+  SessionManager& operator=(const SessionManager&) = delete;
   ~SessionManager();
 
   void LoadSessions(std::string_view filename);
   void SaveSessions(std::string_view filename);
 
+  // called with sessionsMutex held
   void SpawnNvimProcess(uint16_t port);
-  uint16_t GetOrCreateSession(const std::string& session_name);
+  rpc::PipeEndpoint SpawnNvimEmbed();
+  rpc::Endpoint GetOrCreateSession(const std::string& session_name);
   void RemoveSession(const std::string& session_name);
+
+private:
+  struct WarmProcess {
+    rpc::Endpoint endpoint;
+    boost::process::child child;
+    std::chrono::steady_clock::time_point spawned;
+  };
+  // don't compete with the first session's startup
+  static constexpr std::chrono::seconds poolStartDelay{1};
+
+  std::mutex poolMutex;
+  std::condition_variable poolCv;
+  std::deque<WarmProcess> pool;
+  bool poolExit = false;
+  std::thread poolThread;
+
+  WarmProcess SpawnWarm();
+  static void Kill(WarmProcess& process);
+  std::optional<rpc::Endpoint> ClaimWarm();
+  void RunPool();
 };
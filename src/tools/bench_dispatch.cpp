@@ -0,0 +1,230 @@
+// Micro-benchmark for redraw event dispatch.
+//   name lookup    std::unordered_map vs the compile time PerfectHash
+//   index checks   std::set vs the constexpr bitmask from vIndicesMask
+//   ParseUiEvent   whole decode of small events, ns per event
+//   grid_line      full redraws decoded serially and on 1..N pool threads
+// Build the bench_dispatch target and run it, release builds only.
+
+#include "nvim/events/ui.hpp"
+#include "utils/logger.hpp"
+#include "utils/perfect_hash.hpp"
+#include "utils/variant.hpp"
+#include "utils/worker_pool.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <random>
+#include <set>
+#include <thread>
+#include <tuple>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace std::chrono;
+
+// everything nvim sends with ext_linegrid and ext_multigrid
+static constexpr std::array<std::string_view, 30> eventNameList{
+  "grid_line",    "grid_cursor_goto", "win_viewport",   "set_title",
+  "set_icon",     "mode_info_set",    "option_set",     "chdir",
+  "mode_change",  "mouse_on",         "mouse_off",      "busy_start",
+  "busy_stop",    "update_menu",      "flush",          "default_colors_set",
+  "hl_attr_define", "hl_group_set",   "grid_resize",    "grid_clear",
+  "grid_scroll",  "grid_destroy",     "win_pos",        "win_float_pos",
+  "win_external_pos", "win_hide",     "win_close",      "msg_set_pos",
+  "win_viewport_margins", "win_extmark",
+};
+
+// runs fn iterations times, returns ns per call
+static double Measure(size_t iterations, auto&& fn) {
+  auto start = steady_clock::now();
+  for (size_t i = 0; i < iterations; i++) {
+    fn(i);
+  }
+  return duration<double, std::nano>(steady_clock::now() - start).count() / iterations;
+}
+
+static void BenchLookup() {
+  // names point into their own buffers like they would into a receive buffer,
+  // mostly grid_line and grid_cursor_goto like a real redraw stream
+  std::mt19937 rng(1);
+  std::discrete_distribution<size_t> pick({
+    60, 10, 5, 0.1, 0.1, 0.1, 0.5, 0.1, 1, 0.1, 0.1, 0.5, 0.5, 0.1, 5,
+    0.1, 2, 0.5, 1, 0.5, 2, 0.5, 1, 1, 0.1, 0.5, 0.5, 0.5, 1, 0.5,
+  });
+  std::vector<std::string> storage;
+  for (size_t i = 0; i < 4096; i++) {
+    storage.emplace_back(eventNameList[pick(rng)]);
+  }
+  std::vector<std::string_view> stream(storage.begin(), storage.end());
+
+  std::unordered_map<std::string_view, int> map;
+  for (size_t i = 0; i < eventNameList.size(); i++) {
+    map.emplace(eventNameList[i], i);
+  }
+  static constexpr PerfectHash hash(eventNameList);
+
+  constexpr size_t iterations = 20'000'000;
+  volatile int sink = 0;
+  double mapNs = Measure(iterations, [&](size_t i) {
+    auto it = map.find(stream[i & 4095]);
+    sink = sink + (it == map.end() ? -1 : it->second);
+  });
+  double hashNs = Measure(iterations, [&](size_t i) {
+    sink = sink + hash.Find(stream[i & 4095]);
+  });
+  LOG("name lookup    unordered_map {:6.2f}ns  perfect hash {:6.2f}ns", mapNs, hashNs);
+}
+
+static void BenchIndexChecks() {
+  // same set as winTypes in editor/state.cpp
+  std::set<size_t> set{
+    vIndex<UiEvent, WinPos>(),      vIndex<UiEvent, WinFloatPos>(),
+    vIndex<UiEvent, WinExternalPos>(), vIndex<UiEvent, WinHide>(),
+    vIndex<UiEvent, WinClose>(),    vIndex<UiEvent, WinViewport>(),
+  };
+  static constexpr auto mask = vIndicesMask<
+    UiEvent, WinPos, WinFloatPos, WinExternalPos, WinHide, WinClose, WinViewport>();
+
+  std::mt19937 rng(1);
+  std::vector<size_t> indices(4096);
+  for (auto& index : indices) {
+    index = rng() % std::variant_size_v<UiEvent>;
+  }
+
+  constexpr size_t iterations = 20'000'000;
+  volatile int sink = 0;
+  double setNs = Measure(iterations, [&](size_t i) {
+    sink = sink + set.contains(indices[i & 4095]);
+  });
+  double maskNs = Measure(iterations, [&](size_t i) {
+    sink = sink + vMaskContains(mask, indices[i & 4095]);
+  });
+  LOG("index checks   std::set      {:6.2f}ns  bitmask      {:6.2f}ns", setNs, maskNs);
+}
+
+static void BenchParse() {
+  // one call per event so dispatch dominates, hot and cold events mixed
+  msgpack::sbuffer buffer;
+  msgpack::packer<msgpack::sbuffer> pk(buffer);
+  constexpr size_t numEvents = 1000;
+  pk.pack_array(numEvents);
+  for (size_t i = 0; i < numEvents; i++) {
+    if (i % 100 == 99) {
+      pk.pack_array(2);
+      pk.pack("flush");
+      pk.pack_array(0);
+    } else if (i % 4 == 0) {
+      pk.pack_array(2);
+      pk.pack(i % 8 == 0 ? "busy_start" : "busy_stop");
+      pk.pack_array(0);
+    } else {
+      pk.pack_array(2);
+      pk.pack("grid_cursor_goto");
+      pk.pack(std::make_tuple(1, int(i % 50), int(i % 80)));
+    }
+  }
+  std::span<const char> params(buffer.data(), buffer.size());
+
+  UiEvents uiEvents;
+  constexpr size_t iterations = 20'000;
+  LOG_DISABLE(); // flush logs
+  double ns = Measure(iterations, [&](size_t) {
+    ParseUiEvent(params, uiEvents);
+    while (uiEvents.NumFlushes() > 0) {
+      uiEvents.PopFront();
+    }
+  });
+  LOG_ENABLE();
+  LOG("ParseUiEvent   {:6.2f}ns per event", ns / numEvents);
+}
+
+// one grid_line event redrawing every row, like a full redraw of the window
+static msgpack::sbuffer PackFullRedraw(int rows, int cols) {
+  msgpack::sbuffer buffer;
+  msgpack::packer<msgpack::sbuffer> pk(buffer);
+  std::mt19937 rng(1);
+  pk.pack_array(2);
+  pk.pack_array(rows + 1);
+  pk.pack("grid_line");
+  for (int row = 0; row < rows; row++) {
+    // runs of text in a few highlights, some blank space, the odd wide char
+    std::vector<std::tuple<std::string, int, int>> cells;
+    for (int col = 0; col < cols;) {
+      if (rng() % 16 == 0) {
+        int repeat = std::min(int(rng() % 20 + 2), cols - col);
+        cells.emplace_back(" ", 0, repeat);
+        col += repeat;
+      } else {
+        std::string text = rng() % 64 == 0 ? "λ" : std::string(1, 'a' + rng() % 26);
+        cells.emplace_back(text, rng() % 8 == 0 ? int(rng() % 50) : -1, 1);
+        col++;
+      }
+    }
+    pk.pack_array(5);
+    pk.pack(1);
+    pk.pack(row);
+    pk.pack(0);
+    pk.pack_array(cells.size());
+    for (auto& [text, hlId, repeat] : cells) {
+      pk.pack_array(repeat > 1 ? 3 : hlId >= 0 ? 2 : 1);
+      pk.pack(text);
+      if (hlId >= 0 || repeat > 1) pk.pack(std::max(hlId, 0));
+      if (repeat > 1) pk.pack(repeat);
+    }
+    pk.pack(false);
+  }
+  pk.pack_array(2);
+  pk.pack("flush");
+  pk.pack_array(0);
+  return buffer;
+}
+
+static void BenchParallelDecode() {
+  size_t maxThreads = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+  for (auto [rows, cols] : {std::pair{60, 200}, {150, 400}, {300, 800}}) {
+    auto buffer = PackFullRedraw(rows, cols);
+    std::span<const char> params(buffer.data(), buffer.size());
+
+    UiEvents uiEvents;
+    constexpr size_t iterations = 200;
+    auto measure = [&] {
+      return Measure(iterations, [&](size_t) {
+        ParseUiEvent(params, uiEvents);
+        while (uiEvents.NumFlushes() > 0) {
+          uiEvents.PopFront();
+        }
+      });
+    };
+
+    LOG_DISABLE(); // flush logs
+    double serialNs = measure();
+    LOG_ENABLE();
+    LOG(
+      "grid_line      {}x{} ({} KiB)  serial {:7.1f}us", rows, cols,
+      buffer.size() >> 10, serialNs / 1000
+    );
+    for (size_t numThreads = 1; numThreads <= maxThreads; numThreads *= 2) {
+      WorkerPool pool(numThreads);
+      uiEvents.decodePool = &pool;
+      LOG_DISABLE();
+      double ns = measure();
+      LOG_ENABLE();
+      uiEvents.decodePool = nullptr;
+      LOG(
+        "               {:2} threads + caller {:7.1f}us  {:.2f}x", numThreads,
+        ns / 1000, serialNs / ns
+      );
+    }
+  }
+}
+
+int main() {
+  BenchLookup();
+  BenchIndexChecks();
+  BenchParse();
+  BenchParallelDecode();
+}
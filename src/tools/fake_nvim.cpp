@@ -0,0 +1,804 @@
+// Fake nvim for load testing the GUI without a real nvim.
+// Speaks just enough msgpack-rpc for the GUI to start up (option queries,
+// nvim_ui_attach, nvim_input), then sends synthetic redraw workloads
+// at a fixed rate. Run it, then connect the GUI with --connect 127.0.0.1:<port>.
+//
+//   fake_nvim [--port 6666] [--workload lines] [--rate 60] [--duration 0]
+//             [--seed 1] [--hl 256] [--guifont "SF Mono:h15"] [--opt name=value]
+//             [--once]
+//
+// workloads
+//   idle     only echoes typed characters
+//   lines    every row redrawn each tick (grid_line flood), plus an
+//            empty segment followed by a line at the same column
+//   scroll   grid_scroll by one row plus the new bottom row
+//   floats   float windows created and destroyed every tick
+//   hl       hl attrs redefined every tick, each cell a different attr
+//   unicode  like lines, but CJK, emoji and combining characters
+//   mixed    one of the above picked at random each tick
+//
+// --rate 0 sends as fast as the GUI reads, --duration closes the connection
+// after that many seconds (the GUI exits and prints its summary),
+// --once exits after the first GUI disconnects instead of waiting for the next.
+// --opt overrides the neogui options the GUI loads, e.g. window.vsync=false.
+
+#include "asio/ip/tcp.hpp"
+#include "asio/write.hpp"
+#include "msgpack.hpp"
+#include "utils/logger.hpp"
+#include "utils/unicode.hpp"
+
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono;
+using namespace std::chrono_literals;
+using Packer = msgpack::packer<msgpack::sbuffer>;
+using Variant = msgpack::type::variant;
+
+enum class Workload { Idle, Lines, Scroll, Floats, Hl, Unicode, Mixed };
+
+static const std::map<std::string_view, Workload> workloadNames{
+  {"idle", Workload::Idle},       {"lines", Workload::Lines},
+  {"scroll", Workload::Scroll},   {"floats", Workload::Floats},
+  {"hl", Workload::Hl},           {"unicode", Workload::Unicode},
+  {"mixed", Workload::Mixed},
+};
+
+struct Config {
+  uint16_t port = 6666;
+  Workload workload = Workload::Lines;
+  double rate = 60;    // ticks per second, 0 for unthrottled
+  seconds duration{0}; // 0 runs until the GUI disconnects
+  uint32_t seed = 1;
+  int hlCount = 256;
+  std::string guifont = "SF Mono:h15";
+  bool once = false;
+  // answers to "return vim.g.neogui_opts_resolved.<name>", same as lua/init.lua
+  std::map<std::string, Variant, std::less<>> options{
+    {"window.vsync", true},    {"window.highDpi", true},
+    {"window.borderless", false}, {"window.blur", 0},
+    {"margins.top", 0},        {"margins.bottom", 0},
+    {"margins.left", 0},       {"margins.right", 0},
+    {"multigrid", true},       {"macOptAsAlt", true},
+    {"cursorIdleTime", 10},    {"bgColor", 0},
+    {"transparency", 1},       {"maxFps", 0},
+    {"predictiveEcho", false},
+  };
+};
+
+// "true", "false", integers and floats, anything else is a string
+static Variant ParseValue(std::string_view value) {
+  if (value == "true") return true;
+  if (value == "false") return false;
+  int64_t i;
+  auto [intEnd, intEc] = std::from_chars(value.data(), value.data() + value.size(), i);
+  if (intEc == std::errc() && intEnd == value.data() + value.size()) return i;
+  double d;
+  auto [dEnd, dEc] = std::from_chars(value.data(), value.data() + value.size(), d);
+  if (dEc == std::errc() && dEnd == value.data() + value.size()) return d;
+  return std::string(value);
+}
+
+struct Cell {
+  std::string text; // empty for the right half of a wide character
+  int hlId;
+};
+using Line = std::vector<Cell>;
+
+// events of a single redraw notification, packed as they're added
+struct Redraw {
+  msgpack::sbuffer events;
+  Packer pk{events};
+  uint32_t count = 0;
+
+  // pack numCalls argument arrays after this
+  void Event(std::string_view name, uint32_t numCalls) {
+    pk.pack_array(numCalls + 1);
+    pk.pack(name);
+    count++;
+  }
+
+  // one grid_line call, hl_id is left out when it repeats and identical
+  // neighbouring cells are merged with repeat, like nvim does
+  void GridLine(int grid, int row, int col, const Line& cells) {
+    size_t numCells = 0;
+    for (size_t i = 0; i < cells.size(); i++) {
+      if (i == 0 || cells[i].text != cells[i - 1].text ||
+          cells[i].hlId != cells[i - 1].hlId) {
+        numCells++;
+      }
+    }
+    pk.pack_array(5);
+    pk.pack(grid);
+    pk.pack(row);
+    pk.pack(col);
+    pk.pack_array(numCells);
+    int prevHlId = -1;
+    for (size_t i = 0; i < cells.size();) {
+      size_t repeat = 1;
+      while (i + repeat < cells.size() && cells[i + repeat].text == cells[i].text &&
+             cells[i + repeat].hlId == cells[i].hlId) {
+        repeat++;
+      }
+      bool sameHl = cells[i].hlId == prevHlId;
+      pk.pack_array(repeat > 1 ? 3 : sameHl ? 1 : 2);
+      pk.pack(cells[i].text);
+      if (!sameHl || repeat > 1) pk.pack(cells[i].hlId);
+      if (repeat > 1) pk.pack(repeat);
+      prevHlId = cells[i].hlId;
+      i += repeat;
+    }
+    pk.pack(false); // wrap
+  }
+
+  void Clear() {
+    events.clear();
+    count = 0;
+  }
+};
+
+struct Float {
+  int grid;
+  int row;
+  int col;
+  int width;
+  int height;
+};
+
+// One GUI connection. The reader answers requests and echoes input on the
+// calling thread while the workload runs on its own, both write under mutex.
+struct Connection {
+  asio::ip::tcp::socket socket;
+  const Config& config;
+  std::mt19937 rng;
+
+  std::mutex mutex;
+  bool attached = false;
+  bool multigrid = false;
+  int width = 0;
+  int height = 0;
+  int cursorRow = 0;
+  int cursorCol = 0;
+  int nextGrid = 2;
+  std::deque<Float> floats;
+  Redraw redraw;
+  msgpack::sbuffer header;
+
+  std::atomic_bool closed = false;
+  std::atomic_size_t ticks = 0;
+  std::atomic_size_t lateTicks = 0;
+  std::atomic_size_t bytesOut = 0;
+  std::atomic_size_t inputs = 0;
+
+  static constexpr size_t maxFloats = 8;
+
+  Connection(asio::ip::tcp::socket&& _socket, const Config& _config)
+      : socket(std::move(_socket)), config(_config), rng(_config.seed) {
+  }
+
+  void Run();
+
+private:
+  void ReadLoop();
+  void WorkloadLoop();
+  void Close();
+
+  void HandleRequest(const msgpack::object& msg);
+  void HandleNotification(std::string_view method, const msgpack::object& params);
+  // packs the result of method, returns false if it isn't supported
+  bool Answer(std::string_view method, const msgpack::object& args, Packer& pk);
+
+  // hold mutex for everything below
+  void Write(const msgpack::sbuffer& buffer);
+  void SendRedraw();
+  void Tick(Workload workload);
+  void Attach();
+  void DefineHl(int id);
+  void FullRedraw(bool unicode);
+  void Echo(std::string_view keys);
+  void CreateFloat();
+  void CloseFloat();
+  void Finish(); // cursor and flush, then sends the redraw
+
+  int RandInt(int min, int max) {
+    return std::uniform_int_distribution(min, max)(rng);
+  }
+  Line RandomLine(int width, bool unicode);
+};
+
+void Connection::Run() {
+  std::thread workload([this] { WorkloadLoop(); });
+  ReadLoop();
+  Close();
+  workload.join();
+}
+
+void Connection::Close() {
+  closed = true;
+  asio::error_code ec;
+  socket.shutdown(asio::ip::tcp::socket::shutdown_both, ec);
+}
+
+void Connection::ReadLoop() {
+  msgpack::unpacker unpacker;
+  while (!closed) {
+    unpacker.reserve_buffer(64 << 10);
+    asio::error_code ec;
+    size_t length =
+      socket.read_some(asio::buffer(unpacker.buffer(), unpacker.buffer_capacity()), ec);
+    if (ec) {
+      if (ec != asio::error::eof && !closed) LOG_ERR("read: {}", ec.message());
+      return;
+    }
+    unpacker.buffer_consumed(length);
+
+    // bad client data (type_error, parse_error) ends the connection,
+    // Run() still closes and joins the workload
+    try {
+      msgpack::object_handle handle;
+      while (unpacker.next(handle)) {
+        const auto& msg = handle.get();
+        if (msg.type != msgpack::type::ARRAY || msg.via.array.size < 3) continue;
+        int type = msg.via.array.ptr[0].as<int>();
+        if (type == 0 && msg.via.array.size == 4) {
+          HandleRequest(msg);
+        } else if (type == 2) {
+          HandleNotification(
+            msg.via.array.ptr[1].as<std::string_view>(), msg.via.array.ptr[2]
+          );
+        }
+        // responses are ignored, we never make requests
+      }
+    } catch (const std::exception& e) {
+      LOG_ERR("read: invalid message: {}", e.what());
+      return;
+    }
+  }
+}
+
+void Connection::HandleRequest(const msgpack::object& msg) {
+  auto msgid = msg.via.array.ptr[1].as<uint32_t>();
+  auto method = msg.via.array.ptr[2].as<std::string_view>();
+  const auto& params = msg.via.array.ptr[3];
+
+  msgpack::sbuffer result;
+  Packer pk(result);
+  bool ok = true;
+
+  // [results, error], error is [index, type, message]
+  if (method == "nvim_call_atomic") {
+    const auto& calls = params.via.array.ptr[0].via.array;
+    uint32_t done = 0;
+    msgpack::sbuffer results;
+    Packer resultsPk(results);
+    std::string_view failed;
+    for (; done < calls.size; done++) {
+      const auto& call = calls.ptr[done].via.array;
+      auto callMethod = call.ptr[0].as<std::string_view>();
+      if (!Answer(callMethod, call.ptr[1], resultsPk)) {
+        failed = callMethod;
+        break;
+      }
+    }
+    pk.pack_array(2);
+    pk.pack_array(done);
+    result.write(results.data(), results.size());
+    if (done == calls.size) {
+      pk.pack_nil();
+    } else {
+      pk.pack_array(3);
+      pk.pack(done);
+      pk.pack(0);
+      pk.pack("fake_nvim: unsupported method " + std::string(failed));
+    }
+  } else {
+    ok = Answer(method, params, pk);
+  }
+
+  msgpack::sbuffer response;
+  Packer responsePk(response);
+  responsePk.pack_array(4);
+  responsePk.pack(1);
+  responsePk.pack(msgid);
+  if (ok) {
+    responsePk.pack_nil();
+    response.write(result.data(), result.size());
+  } else {
+    responsePk.pack_array(2);
+    responsePk.pack(0);
+    responsePk.pack("fake_nvim: unsupported method " + std::string(method));
+    responsePk.pack_nil();
+  }
+
+  std::scoped_lock lock(mutex);
+  Write(response);
+}
+
+bool Connection::Answer(std::string_view method, const msgpack::object& args, Packer& pk) {
+  static constexpr std::string_view optionPrefix = "return vim.g.neogui_opts_resolved.";
+
+  if (method == "nvim_exec_lua") {
+    auto code = args.via.array.ptr[0].as<std::string_view>();
+    if (code.starts_with(optionPrefix)) {
+      auto it = config.options.find(code.substr(optionPrefix.size()));
+      if (it != config.options.end()) {
+        pk.pack(it->second);
+        return true;
+      }
+    }
+    // resolve_neogui_opts() and anything else returns nothing
+    pk.pack_nil();
+    return true;
+
+  } else if (method == "nvim_get_option_value") {
+    auto name = args.via.array.ptr[0].as<std::string_view>();
+    if (name == "guifont") {
+      pk.pack(config.guifont);
+    } else {
+      pk.pack_nil();
+    }
+    return true;
+
+  } else if (method == "nvim_paste") {
+    pk.pack(true);
+    return true;
+
+  } else if (method == "nvim_list_uis") {
+    pk.pack_array(0);
+    return true;
+  }
+  return false;
+}
+
+void Connection::HandleNotification(
+  std::string_view method, const msgpack::object& params
+) {
+  const auto& args = params.via.array;
+  std::scoped_lock lock(mutex);
+
+  if (method == "nvim_ui_attach") {
+    width = args.ptr[0].as<int>();
+    height = args.ptr[1].as<int>();
+    auto options = args.ptr[2].as<std::map<std::string, msgpack::object>>();
+    if (auto it = options.find("ext_multigrid"); it != options.end()) {
+      multigrid = it->second.as<bool>();
+    }
+    LOG_INFO("ui attached {}x{}, multigrid {}", width, height, multigrid);
+    Attach();
+
+  } else if (method == "nvim_ui_try_resize") {
+    width = args.ptr[0].as<int>();
+    height = args.ptr[1].as<int>();
+    cursorRow = std::min(cursorRow, height - 1);
+    cursorCol = std::min(cursorCol, width - 1);
+    // inline floats were drawn over by the full redraw
+    if (!multigrid) floats.clear();
+    redraw.Event("grid_resize", 1);
+    redraw.pk.pack(std::make_tuple(1, width, height));
+    FullRedraw(false);
+    Finish();
+
+  } else if (method == "nvim_ui_detach") {
+    attached = false;
+
+  } else if (method == "nvim_input") {
+    inputs++;
+    Echo(args.ptr[0].as<std::string_view>());
+  }
+}
+
+void Connection::Write(const msgpack::sbuffer& buffer) {
+  if (closed) return;
+  asio::error_code ec;
+  asio::write(socket, asio::buffer(buffer.data(), buffer.size()), ec);
+  if (ec) {
+    Close();
+    return;
+  }
+  bytesOut += buffer.size();
+}
+
+void Connection::SendRedraw() {
+  header.clear();
+  Packer pk(header);
+  pk.pack_array(3);
+  pk.pack(2);
+  pk.pack("redraw");
+  pk.pack_array(redraw.count);
+
+  if (!closed) {
+    std::array buffers{
+      asio::buffer(header.data(), header.size()),
+      asio::buffer(redraw.events.data(), redraw.events.size()),
+    };
+    asio::error_code ec;
+    asio::write(socket, buffers, ec);
+    if (ec) {
+      Close();
+    } else {
+      bytesOut += header.size() + redraw.events.size();
+    }
+  }
+  redraw.Clear();
+}
+
+void Connection::Attach() {
+  attached = true;
+  cursorRow = 0;
+  cursorCol = 0;
+  floats.clear();
+
+  redraw.Event("default_colors_set", 1);
+  redraw.pk.pack(std::make_tuple(0xdcdcdc, 0x1e1e1e, 0xff0000, 0, 0));
+
+  redraw.Event("hl_attr_define", config.hlCount);
+  for (int id = 1; id <= config.hlCount; id++) {
+    DefineHl(id);
+  }
+
+  redraw.Event("mode_info_set", 1);
+  redraw.pk.pack_array(2);
+  redraw.pk.pack(true);
+  redraw.pk.pack(std::vector<std::map<std::string, Variant>>{
+    {{"name", "normal"}, {"cursor_shape", "block"}, {"cell_percentage", 100}},
+    {{"name", "insert"}, {"cursor_shape", "vertical"}, {"cell_percentage", 25}},
+  });
+
+  redraw.Event("grid_resize", 1);
+  redraw.pk.pack(std::make_tuple(1, width, height));
+  FullRedraw(false);
+
+  // insert mode, so typed characters can be predicted
+  redraw.Event("mode_change", 1);
+  redraw.pk.pack(std::make_tuple("insert", 1));
+  Finish();
+}
+
+// [id, rgb_attrs, cterm_attrs, info], packs the arguments only
+void Connection::DefineHl(int id) {
+  static constexpr std::array flags{"bold", "italic", "strikethrough", "underline",
+                                    "undercurl", "reverse"};
+  std::map<std::string, Variant> attrs;
+  attrs["foreground"] = int64_t(rng() & 0xffffff);
+  if (RandInt(0, 3) == 0) attrs["background"] = int64_t(rng() & 0xffffff);
+  if (RandInt(0, 1) == 0) attrs[flags[RandInt(0, flags.size() - 1)]] = true;
+
+  redraw.pk.pack_array(4);
+  redraw.pk.pack(id);
+  redraw.pk.pack(attrs);
+  redraw.pk.pack_map(0);
+  redraw.pk.pack_array(0);
+}
+
+Line Connection::RandomLine(int lineWidth, bool unicode) {
+  static constexpr std::array emoji{0x1f600, 0x1f680, 0x1f44d, 0x1f525, 0x1f389,
+                                    0x1f914, 0x2764,  0x1f30d};
+  Line line;
+  line.reserve(lineWidth);
+  int hlId = RandInt(1, config.hlCount);
+  while (int(line.size()) < lineWidth) {
+    // words separated by spaces, highlight changes every few words
+    if (RandInt(0, 5) == 0) hlId = RandInt(1, config.hlCount);
+    int wordLen = RandInt(1, 10);
+    for (int i = 0; i < wordLen && int(line.size()) < lineWidth; i++) {
+      bool wideFits = int(line.size()) + 2 <= lineWidth;
+      int kind = unicode ? RandInt(0, 9) : 0;
+      if (kind >= 6 && wideFits) {
+        // CJK ideograph or emoji, double width
+        uint32_t code = kind >= 8 ? emoji[RandInt(0, emoji.size() - 1)]
+                                  : 0x4e00 + RandInt(0, 0x51ff);
+        line.push_back({UnicodeToUTF8(code), hlId});
+        line.push_back({"", hlId});
+      } else if (kind == 5) {
+        // latin letter with a combining accent, one cell
+        line.push_back({char('a' + RandInt(0, 25)) + UnicodeToUTF8(0x301), hlId});
+      } else {
+        line.push_back({std::string(1, char('a' + RandInt(0, 25))), hlId});
+      }
+    }
+    if (int(line.size()) < lineWidth) line.push_back({" ", hlId});
+  }
+  return line;
+}
+
+void Connection::FullRedraw(bool unicode) {
+  redraw.Event("grid_line", height);
+  for (int row = 0; row < height; row++) {
+    redraw.GridLine(1, row, 0, RandomLine(width, unicode));
+  }
+}
+
+void Connection::Finish() {
+  redraw.Event("grid_cursor_goto", 1);
+  redraw.pk.pack(std::make_tuple(1, cursorRow, cursorCol));
+  redraw.Event("flush", 1);
+  redraw.pk.pack_array(0);
+  SendRedraw();
+}
+
+// typed characters are written at the cursor, enough for
+// measuring input latency and trying out predictive echo
+void Connection::Echo(std::string_view keys) {
+  if (!attached) return;
+  std::string text;
+  if (keys == "<lt>") {
+    text = "<";
+  } else if (keys == "<CR>") {
+    cursorRow = (cursorRow + 1) % height;
+    cursorCol = 0;
+  } else if (keys == "<BS>") {
+    if (cursorCol > 0) cursorCol--;
+    text = " ";
+  } else if (!keys.starts_with('<')) {
+    text = keys;
+  }
+
+  if (!text.empty()) {
+    redraw.Event("grid_line", 1);
+    redraw.GridLine(1, cursorRow, cursorCol, {{text, 0}});
+    if (keys != "<BS>") cursorCol++;
+    if (cursorCol >= width) {
+      cursorRow = (cursorRow + 1) % height;
+      cursorCol = 0;
+    }
+  }
+  Finish();
+}
+
+// floats are separate grids with ext_multigrid, drawn into grid 1 otherwise
+void Connection::CreateFloat() {
+  Float f{
+    .grid = nextGrid++,
+    .width = std::min(RandInt(10, 40), width),
+    .height = std::min(RandInt(3, 12), height),
+  };
+  f.row = RandInt(0, height - f.height);
+  f.col = RandInt(0, width - f.width);
+  int grid = multigrid ? f.grid : 1;
+
+  if (multigrid) {
+    redraw.Event("grid_resize", 1);
+    redraw.pk.pack(std::make_tuple(f.grid, f.width, f.height));
+    // [grid, win, anchor, anchor_grid, anchor_row, anchor_col, focusable, zindex]
+    redraw.Event("win_float_pos", 1);
+    redraw.pk.pack_array(8);
+    redraw.pk.pack(f.grid);
+    redraw.pk.pack_ext(sizeof(int32_t), 1); // window handle
+    int32_t handle = 1000 + f.grid;
+    redraw.pk.pack_ext_body(reinterpret_cast<const char*>(&handle), sizeof(handle));
+    redraw.pk.pack("NW");
+    redraw.pk.pack(1);
+    redraw.pk.pack(double(f.row));
+    redraw.pk.pack(double(f.col));
+    redraw.pk.pack(true);
+    redraw.pk.pack(50);
+  }
+
+  redraw.Event("grid_line", f.height);
+  for (int row = 0; row < f.height; row++) {
+    redraw.GridLine(
+      grid, multigrid ? row : f.row + row, multigrid ? 0 : f.col,
+      RandomLine(f.width, false)
+    );
+  }
+  floats.push_back(f);
+}
+
+void Connection::CloseFloat() {
+  auto f = floats.front();
+  floats.pop_front();
+  if (multigrid) {
+    redraw.Event("win_close", 1);
+    redraw.pk.pack(std::make_tuple(f.grid));
+    redraw.Event("grid_destroy", 1);
+    redraw.pk.pack(std::make_tuple(f.grid));
+    return;
+  }
+  // redraw what was underneath
+  redraw.Event("grid_line", f.height);
+  for (int row = 0; row < f.height; row++) {
+    redraw.GridLine(1, f.row + row, 0, RandomLine(width, false));
+  }
+}
+
+void Connection::Tick(Workload workload) {
+  if (workload == Workload::Mixed) {
+    workload = Workload(RandInt(int(Workload::Lines), int(Workload::Unicode)));
+  }
+
+  switch (workload) {
+    case Workload::Lines: {
+      FullRedraw(false);
+      // an empty segment, then a line starting where it does, which
+      // coalescing mustn't merge into the empty one
+      int row = RandInt(0, height - 1);
+      redraw.Event("grid_line", 2);
+      redraw.GridLine(1, row, 0, {});
+      redraw.GridLine(1, row, 0, RandomLine(width, false));
+      break;
+    }
+
+    case Workload::Scroll: {
+      // [grid, top, bot, left, right, rows, cols]
+      redraw.Event("grid_scroll", 1);
+      redraw.pk.pack(std::make_tuple(1, 0, height, 0, width, 1, 0));
+      redraw.Event("grid_line", 1);
+      redraw.GridLine(1, height - 1, 0, RandomLine(width, false));
+      break;
+    }
+
+    case Workload::Floats:
+      CreateFloat();
+      if (floats.size() > maxFloats) CloseFloat();
+      break;
+
+    case Workload::Hl: {
+      constexpr int batch = 64;
+      redraw.Event("hl_attr_define", batch);
+      for (int i = 0; i < batch; i++) {
+        DefineHl(RandInt(1, config.hlCount));
+      }
+      redraw.Event("grid_line", height);
+      for (int row = 0; row < height; row++) {
+        Line line(width);
+        for (auto& cell : line) {
+          cell = {std::string(1, char('a' + RandInt(0, 25))), RandInt(1, config.hlCount)};
+        }
+        redraw.GridLine(1, row, 0, line);
+      }
+      break;
+    }
+
+    case Workload::Unicode:
+      FullRedraw(true);
+      break;
+
+    case Workload::Idle:
+    case Workload::Mixed:
+      return;
+  }
+  Finish();
+  ticks++;
+}
+
+void Connection::WorkloadLoop() {
+  auto period = config.rate > 0 ? duration_cast<nanoseconds>(1s / config.rate)
+                                : nanoseconds(0);
+  auto start = steady_clock::now();
+  auto nextTick = start;
+  auto nextReport = start + 1s;
+  size_t prevTicks = 0;
+  size_t prevBytes = 0;
+  size_t prevInputs = 0;
+
+  while (!closed) {
+    auto now = steady_clock::now();
+    if (config.duration.count() > 0 && now - start >= config.duration) {
+      LOG_INFO("duration reached, closing the connection");
+      Close();
+      break;
+    }
+    if (now >= nextReport) {
+      size_t currTicks = ticks;
+      size_t currBytes = bytesOut;
+      size_t currInputs = inputs;
+      LOG(
+        "{} ticks/s ({} late total), {:.2f} MB/s, {} inputs/s", currTicks - prevTicks,
+        size_t(lateTicks), (currBytes - prevBytes) / 1e6, currInputs - prevInputs
+      );
+      prevTicks = currTicks;
+      prevBytes = currBytes;
+      prevInputs = currInputs;
+      nextReport += 1s;
+    }
+
+    bool ready;
+    {
+      std::scoped_lock lock(mutex);
+      ready = attached && config.workload != Workload::Idle;
+      if (ready) Tick(config.workload);
+    }
+    if (!ready) {
+      std::this_thread::sleep_for(10ms);
+      nextTick = steady_clock::now();
+      continue;
+    }
+
+    if (period.count() > 0) {
+      nextTick += period;
+      now = steady_clock::now();
+      if (now > nextTick + period) {
+        // fell behind (the GUI isn't reading fast enough), don't burst to catch up
+        lateTicks++;
+        nextTick = now;
+      }
+      std::this_thread::sleep_until(nextTick);
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  Config config;
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--port" && hasValue) {
+      config.port = std::atoi(argv[++i]);
+    } else if (arg == "--workload" && hasValue) {
+      auto it = workloadNames.find(argv[++i]);
+      if (it == workloadNames.end()) {
+        LOG_ERR("Unknown workload: {}", argv[i]);
+        return 1;
+      }
+      config.workload = it->second;
+    } else if (arg == "--rate" && hasValue) {
+      config.rate = std::atof(argv[++i]);
+    } else if (arg == "--duration" && hasValue) {
+      config.duration = seconds(std::atoi(argv[++i]));
+    } else if (arg == "--seed" && hasValue) {
+      config.seed = std::atoi(argv[++i]);
+    } else if (arg == "--hl" && hasValue) {
+      config.hlCount = std::max(std::atoi(argv[++i]), 1);
+    } else if (arg == "--guifont" && hasValue) {
+      config.guifont = argv[++i];
+    } else if (arg == "--once") {
+      config.once = true;
+    } else if (arg == "--opt" && hasValue) {
+      std::string_view opt = argv[++i];
+      auto eq = opt.find('=');
+      if (eq == std::string_view::npos) {
+        LOG_ERR("--opt expects name=value, got {}", opt);
+        return 1;
+      }
+      config.options.insert_or_assign(
+        std::string(opt.substr(0, eq)), ParseValue(opt.substr(eq + 1))
+      );
+    } else {
+      LOG_WARN("Unknown argument: {}", arg);
+    }
+  }
+
+  try {
+    asio::io_context context;
+    asio::ip::tcp::acceptor acceptor(
+      context, {asio::ip::address_v4::loopback(), config.port}
+    );
+    LOG_INFO("fake_nvim listening on 127.0.0.1:{}", config.port);
+
+    // one GUI at a time, the same seed gives the same workload every connection
+    while (true) {
+      asio::ip::tcp::socket socket(context);
+      acceptor.accept(socket);
+      socket.set_option(asio::ip::tcp::no_delay(true));
+      LOG_INFO("GUI connected");
+
+      Connection connection(std::move(socket), config);
+      auto start = steady_clock::now();
+      connection.Run();
+      auto elapsed = duration<double>(steady_clock::now() - start).count();
+
+      LOG_INFO(
+        "GUI disconnected after {:.1f}s: {} ticks ({} late), {:.1f} MB sent, "
+        "{} inputs",
+        elapsed, size_t(connection.ticks), size_t(connection.lateTicks),
+        connection.bytesOut / 1e6, size_t(connection.inputs)
+      );
+      if (config.once) break;
+    }
+  } catch (const std::exception& e) {
+    LOG_ERR("{}", e.what());
+    return 1;
+  }
+}
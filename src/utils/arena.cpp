@@ -0,0 +1,55 @@
+#include "arena.hpp"
+
+#include <algorithm>
+#include <ranges>
+
+void* Arena::AllocateSlow(size_t size, size_t align) {
+  // blocks start aligned to max_align_t (new[]), so align only matters
+  // within a block. move on to the next kept block that fits
+  while (current + 1 < blocks.size()) {
+    current++;
+    if (size <= blocks[current].size) {
+      offset = size;
+      return blocks[current].data.get();
+    }
+  }
+
+  size_t newSize = std::max(blockSize, size + align);
+  blocks.push_back({std::make_unique_for_overwrite<std::byte[]>(newSize), newSize});
+  current = blocks.size() - 1;
+  offset = size;
+  return blocks[current].data.get();
+}
+
+void Arena::Reset() {
+  for (auto& finalizer : finalizers | std::views::reverse) {
+    finalizer.destroy(finalizer.object);
+  }
+  finalizers.clear();
+
+  size_t kept = 0;
+  size_t numKept = 0;
+  while (numKept < blocks.size() && kept + blocks[numKept].size <= maxKeptBytes) {
+    kept += blocks[numKept].size;
+    numKept++;
+  }
+  blocks.resize(numKept);
+  current = 0;
+  offset = 0;
+}
+
+size_t Arena::BytesUsed() const {
+  size_t used = offset;
+  for (size_t i = 0; i < current && i < blocks.size(); i++) {
+    used += blocks[i].size;
+  }
+  return used;
+}
+
+size_t Arena::Capacity() const {
+  size_t capacity = 0;
+  for (const auto& block : blocks) {
+    capacity += block.size;
+  }
+  return capacity;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump allocator for data that's released all at once.
+// Reset() rewinds without freeing, so an arena that's reused stops
+// allocating once it has seen its largest batch.
+// Objects that aren't trivially destructible have their destructors
+// run by Reset(), in reverse order.
+struct Arena {
+  static constexpr size_t blockSize = 64 << 10;
+  // blocks past this are freed on Reset(), so one huge batch doesn't pin memory
+  static constexpr size_t maxKeptBytes = 4 << 20;
+
+  Arena() = default;
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+  Arena(Arena&&) = default;
+  Arena& operator=(Arena&&) = default;
+  ~Arena() {
+    Reset();
+  }
+
+  void* Allocate(size_t size, size_t align = alignof(std::max_align_t)) {
+    if (current < blocks.size()) {
+      size_t start = (offset + align - 1) & ~(align - 1);
+      if (start + size <= blocks[current].size) {
+        offset = start + size;
+        return blocks[current].data.get() + start;
+      }
+    }
+    return AllocateSlow(size, align);
+  }
+
+  template <typename T, typename... Args>
+  T* New(Args&&... args) {
+    auto* object = new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    if constexpr (!std::is_trivially_destructible_v<T>) {
+      finalizers.push_back({[](void* p) { static_cast<T*>(p)->~T(); }, object});
+    }
+    return object;
+  }
+
+  // uninitialized storage for count Ts, no destructors are run
+  template <typename T>
+  std::span<T> NewArray(size_t count) {
+    static_assert(std::is_trivially_destructible_v<T>);
+    if (count == 0) return {};
+    return {static_cast<T*>(Allocate(sizeof(T) * count, alignof(T))), count};
+  }
+
+  std::string_view Copy(std::string_view str) {
+    if (str.empty()) return {};
+    auto* data = static_cast<char*>(Allocate(str.size(), 1));
+    std::copy(str.begin(), str.end(), data);
+    return {data, str.size()};
+  }
+
+  // destroys everything allocated, keeps the blocks
+  void Reset();
+
+  size_t BytesUsed() const;
+  size_t Capacity() const;
+
+private:
+  struct Block {
+    std::unique_ptr<std::byte[]> data;
+    size_t size;
+  };
+  std::vector<Block> blocks;
+  size_t current = 0; // block being allocated from
+  size_t offset = 0;  // into blocks[current]
+
+  struct Finalizer {
+    void (*destroy)(void*);
+    void* object;
+  };
+  std::vector<Finalizer> finalizers;
+
+  void* AllocateSlow(size_t size, size_t align);
+};
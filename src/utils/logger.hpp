@@ -5,7 +5,8 @@
 #include <format>
 
 struct Logger {
-  bool enabled = true;
+  // LOG_DISABLE() only silences the calling thread
+  static inline thread_local bool enabled = true;
 
   void Log(const std::string& message);
 
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+// Perfect hash over a fixed set of strings, built at compile time.
+// Find() hashes the key once and does a single compare, no probing.
+//   static constexpr PerfectHash names(std::array<std::string_view, 3>{"a", "b", "c"});
+//   names.Find("b") == 1
+template <size_t N>
+struct PerfectHash {
+  // 4x the keys keeps collisions rare, so a seed is found in a few tries
+  static constexpr size_t numSlots = std::bit_ceil(N * 4);
+  static_assert(N < 255, "PerfectHash: slots are 8 bit");
+
+  std::array<std::string_view, N> keys{};
+  std::array<uint8_t, numSlots> slots{}; // key index + 1, 0 is empty
+  uint32_t seed = 0;
+
+  constexpr PerfectHash(const std::array<std::string_view, N>& _keys) : keys(_keys) {
+    for (seed = 1; seed < 100000; seed++) {
+      if (TryBuild()) return;
+    }
+    // keys that hash the same for every seed, fails the constant evaluation
+    throw "PerfectHash: no seed found, keys must differ in length or first/last 8 bytes";
+  }
+
+  // index of key in the original array, -1 if it isn't one of them
+  constexpr int Find(std::string_view key) const {
+    int slot = slots[Hash(key, seed) & (numSlots - 1)];
+    if (slot == 0 || keys[slot - 1] != key) return -1;
+    return slot - 1;
+  }
+
+  // only the length and the first and last 8 bytes are hashed, a couple of
+  // loads instead of a loop over every byte. keys must differ somewhere in
+  // those, or no seed is found and the build fails
+  static constexpr uint32_t Hash(std::string_view key, uint32_t seed) {
+    uint64_t first = Load(key, 0);
+    uint64_t last = Load(key, key.size() > 8 ? key.size() - 8 : 0);
+    uint64_t hash = (first ^ seed) * 0x9e3779b97f4a7c15ull;
+    hash ^= std::rotl(last * 0xc2b2ae3d27d4eb4full, 31) ^ key.size();
+    hash *= 0x165667b19e3779f9ull;
+    return uint32_t(hash >> 32);
+  }
+
+private:
+  // up to 8 bytes from offset, little endian
+  static constexpr uint64_t Load(std::string_view key, size_t offset) {
+    if !consteval {
+      if (key.size() - offset >= 8) {
+        uint64_t value;
+        std::memcpy(&value, key.data() + offset, 8);
+        if constexpr (std::endian::native == std::endian::big) {
+          value = std::byteswap(value);
+        }
+        return value;
+      }
+    }
+    uint64_t value = 0;
+    size_t size = std::min<size_t>(8, key.size() - offset);
+    for (size_t i = 0; i < size; i++) {
+      value |= uint64_t(uint8_t(key[offset + i])) << (i * 8);
+    }
+    return value;
+  }
+
+  constexpr bool TryBuild() {
+    slots.fill(0);
+    for (size_t i = 0; i < N; i++) {
+      auto& slot = slots[Hash(keys[i], seed) & (numSlots - 1)];
+      if (slot != 0) return false;
+      slot = i + 1;
+    }
+    return true;
+  }
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Busy time of pipeline stages running on different threads, and how long
+// each pair of stages was busy at the same time.
+// Stage is an enum class ending in Count. Each stage is timed from the thread
+// running it, one interval at a time. Overlap of two intervals is counted by
+// whichever ends first, the other one is still running at that point.
+template <typename Stage>
+struct StageTimes {
+  static constexpr size_t numStages = size_t(Stage::Count);
+
+  void Begin(Stage stage) {
+    busySince[size_t(stage)].store(Now(), std::memory_order_relaxed);
+  }
+
+  void End(Stage stage) {
+    size_t s = size_t(stage);
+    int64_t end = Now();
+    int64_t start = busySince[s].exchange(0, std::memory_order_relaxed);
+    if (start == 0) return;
+    busy[s].fetch_add(end - start, std::memory_order_relaxed);
+
+    for (size_t other = 0; other < numStages; other++) {
+      if (other == s) continue;
+      int64_t otherStart = busySince[other].load(std::memory_order_relaxed);
+      if (otherStart == 0) continue;
+      int64_t shared = end - std::max(start, otherStart);
+      if (shared > 0) {
+        overlap[std::min(s, other)][std::max(s, other)].fetch_add(
+          shared, std::memory_order_relaxed
+        );
+      }
+    }
+  }
+
+  std::chrono::nanoseconds Busy(Stage stage) const {
+    return std::chrono::nanoseconds(busy[size_t(stage)].load());
+  }
+
+  std::chrono::nanoseconds Overlap(Stage a, Stage b) const {
+    size_t i = std::min(size_t(a), size_t(b));
+    size_t j = std::max(size_t(a), size_t(b));
+    return std::chrono::nanoseconds(overlap[i][j].load());
+  }
+
+private:
+  // steady clock ns, 0 when the stage is idle
+  std::array<std::atomic<int64_t>, numStages> busySince{};
+  std::array<std::atomic<int64_t>, numStages> busy{};
+  std::array<std::array<std::atomic<int64_t>, numStages>, numStages> overlap{};
+
+  static int64_t Now() {
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+  }
+};
@@ -7,8 +7,9 @@ std::string UnicodeToUTF8(uint32_t unicode) {
   return utf8String;
 }
 
-uint32_t UTF8ToUnicode(const std::string& utf8String) {
+uint32_t UTF8ToUnicode(std::string_view utf8String) {
+  if (utf8String.empty()) return 0;
+  if (uint8_t(utf8String[0]) < 0x80) return utf8String[0];
   auto it = utf8String.begin();
-  if (it == utf8String.end()) return 0;
   return utf8::next(it, utf8String.end());
 }
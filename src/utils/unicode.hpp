@@ -1,7 +1,10 @@
 #pragma once 
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 
 std::string UnicodeToUTF8(uint32_t unicode);
 
-uint32_t UTF8ToUnicode(const std::string& utf8String);
+// first codepoint, 0 if empty
+uint32_t UTF8ToUnicode(std::string_view utf8String);
@@ -1,7 +1,7 @@
 #pragma once
 
+#include <cstdint>
 #include <variant>
-#include <set>
 
 template <class... Ts>
 struct overloaded : Ts... {
@@ -24,9 +24,15 @@ constexpr std::size_t vIndex() {
   }
 }
 
+// bit i is set if alternative i is one of Types, check with vMaskContains
 template <typename VariantType, typename... Types>
-constexpr auto vIndicesSet() {
-  return std::set<std::size_t>{vIndex<VariantType, Types>()...};
+constexpr uint64_t vIndicesMask() {
+  static_assert(std::variant_size_v<VariantType> <= 64, "Variant too large for mask");
+  return ((uint64_t(1) << vIndex<VariantType, Types>()) | ...);
+}
+
+constexpr bool vMaskContains(uint64_t mask, std::size_t index) {
+  return index < 64 && (mask >> index) & 1;
 }
 
 template <typename T>
@@ -0,0 +1,69 @@
+#include "worker_pool.hpp"
+
+WorkerPool::WorkerPool(size_t numThreads) {
+  threads.reserve(numThreads);
+  for (size_t i = 0; i < numThreads; i++) {
+    threads.emplace_back([this] { Work(); });
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard lock(mutex);
+    stopping = true;
+  }
+  jobCv.notify_all();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+void WorkerPool::Run(size_t numParts, const std::function<void(size_t)>& fn) {
+  std::unique_lock runLock(runMutex, std::try_to_lock);
+  if (!runLock || threads.empty() || numParts <= 1) {
+    for (size_t part = 0; part < numParts; part++) {
+      fn(part);
+    }
+    return;
+  }
+
+  std::unique_lock lock(mutex);
+  job = &fn;
+  numJobParts = numParts;
+  nextPart = 0;
+  generation++;
+  lock.unlock();
+  jobCv.notify_all();
+
+  lock.lock();
+  RunParts(lock);
+  // workers that woke late see job cleared and go back to sleep
+  doneCv.wait(lock, [&] { return numBusy == 0; });
+  job = nullptr;
+}
+
+void WorkerPool::Work() {
+  uint64_t seen = 0;
+  std::unique_lock lock(mutex);
+  while (true) {
+    jobCv.wait(lock, [&] { return stopping || generation != seen; });
+    if (stopping) return;
+    seen = generation;
+    if (job == nullptr) continue;
+
+    numBusy++;
+    RunParts(lock);
+    if (--numBusy == 0) doneCv.notify_one();
+  }
+}
+
+void WorkerPool::RunParts(std::unique_lock<std::mutex>& lock) {
+  // parts are few and large, so claiming them under the lock is cheap
+  const auto& fn = *job;
+  while (nextPart < numJobParts) {
+    size_t part = nextPart++;
+    lock.unlock();
+    fn(part);
+    lock.lock();
+  }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Threads for splitting one job into parts that run at the same time.
+// Run() blocks until every part is done, the calling thread takes parts too.
+// A Run() from another thread while a job is in progress runs its parts on
+// the caller alone instead of waiting, so sessions can share a pool.
+struct WorkerPool {
+  explicit WorkerPool(size_t numThreads);
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+  ~WorkerPool();
+
+  // not counting the caller
+  size_t NumThreads() const {
+    return threads.size();
+  }
+
+  // calls fn(part) for every part in [0, numParts)
+  void Run(size_t numParts, const std::function<void(size_t)>& fn);
+
+private:
+  std::vector<std::thread> threads;
+  std::mutex runMutex; // held by the thread whose job is running
+
+  std::mutex mutex;
+  std::condition_variable jobCv;  // new job or stopping
+  std::condition_variable doneCv; // a worker finished its parts
+  bool stopping = false;
+  uint64_t generation = 0; // bumped per job, workers join each job once
+  const std::function<void(size_t)>* job = nullptr;
+  size_t numJobParts = 0;
+  size_t nextPart = 0;
+  size_t numBusy = 0; // workers between claiming parts and finishing them
+
+  void Work();
+  // claims and runs parts until none are left, holds lock between parts
+  void RunParts(std::unique_lock<std::mutex>& lock);
+};